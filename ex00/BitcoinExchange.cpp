@@ -1,100 +1,127 @@
 #include "BitcoinExchange.hpp"
-#include <cmath>
+#include "DatabaseLoader.hpp"
+#include "Helpers.hpp"
+#include "Snapshot.hpp"
+#include "FloatParser.hpp"
+#include "FloatFormatter.hpp"
+#include "MappedFile.hpp"
+#include "ColumnStore.hpp"
+#include "TickIndex.hpp"
+#include "Timestamp.hpp"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <cerrno>
+#include <pthread.h>
+#include <algorithm>
+#include <cstring>
 
 BitcoinExchange::BitcoinExchange()
+    : _threads(1), _useSnapshot(true), _dense(false), _assets(NULL), _ticks(NULL)
 {
 }
 
 BitcoinExchange::BitcoinExchange(const BitcoinExchange& other)
+    : _database(other._database)
 {
-    _database = other._database;
+    _source = other._source;
+    _threads = other._threads;
+    _useSnapshot = other._useSnapshot;
+    _dense = other._dense;
+    _assets = ColumnStore::retain(other._assets);
+    _ticks = TickIndex::retain(other._ticks);
 }
 
 BitcoinExchange& BitcoinExchange::operator=(const BitcoinExchange& other)
 {
     if (this != &other)
     {
+        _source = other._source;
+        _threads = other._threads;
+        _useSnapshot = other._useSnapshot;
+        _dense = other._dense;
         _database = other._database;
+        const ColumnStore* assets = ColumnStore::retain(other._assets);
+        ColumnStore::release(_assets);
+        _assets = assets;
+        const TickIndex* ticks = TickIndex::retain(other._ticks);
+        TickIndex::release(_ticks);
+        _ticks = ticks;
     }
     return *this;
 }
 
 BitcoinExchange::~BitcoinExchange()
 {
+    ColumnStore::release(_assets);
+    TickIndex::release(_ticks);
 }
 
 /**
- * Helper: Convert string to float
- * Handles conversion errors gracefully
+ * Publish a private copy of another version (dense toggling)
+ * Copies of BitcoinExchange share versions instead (LiveIndex::share)
  */
-float BitcoinExchange::stringToFloat(const std::string& str)
+void BitcoinExchange::publishCopy(const LiveIndex::Version& from)
 {
-    char* endptr;
-    errno = 0;
-    float value = std::strtof(str.c_str(), &endptr);
-    
-    // Check for conversion errors
-    if (errno == ERANGE || *endptr != '\0')
-    {
-        throw std::runtime_error("Invalid float conversion");
-    }
-    return value;
+    LiveIndex::Version* next = new LiveIndex::Version(from);
+    next->index.setDenseLookup(_dense);
+    _database.lockWriters();
+    _database.publish(next);
+    _database.unlockWriters();
+}
+
+/**
+ * Number of threads used for loading and processing (at least 1)
+ */
+void BitcoinExchange::setThreadCount(size_t threads)
+{
+    _threads = threads ? threads : 1;
+}
+
+/**
+ * Resolve lookups through PriceIndex's forward-filled calendar table
+ * (falls back to binary search by itself when the dates are sparse)
+ */
+void BitcoinExchange::setDenseLookup(bool enabled)
+{
+    _dense = enabled;
+    LiveIndex::Reader current(_database);
+    publishCopy(*current);
+}
+
+/**
+ * Enable/disable reading and refreshing "<csv>.snap" in loadDatabase
+ */
+void BitcoinExchange::setSnapshotEnabled(bool enabled)
+{
+    _useSnapshot = enabled;
 }
 
 /**
  * Helper: Validate date format YYYY-MM-DD
  * Also checks if date is realistic (1900-2999, months 01-12, days 01-31)
+ * On success, key receives the packed day number (see DateKey)
  */
-bool BitcoinExchange::isValidDate(const std::string& date)
+bool BitcoinExchange::isValidDate(const char* date, size_t len, uint32_t& key) const
 {
-    // Check format: YYYY-MM-DD
-    if (date.length() != 10)
-        return false;
-    
-    if (date[4] != '-' || date[7] != '-')
-        return false;
-    
-    // Check all digits
-    for (int i = 0; i < 10; i++)
-    {
-        if (i == 4 || i == 7)
-            continue;
-        if (!std::isdigit(date[i]))
-            return false;
-    }
-    
-    // Parse year, month, day
-    int year = std::atoi(date.substr(0, 4).c_str());
-    int month = std::atoi(date.substr(5, 2).c_str());
-    int day = std::atoi(date.substr(8, 2).c_str());
-    
-    // Validate ranges
-    if (year < 1900 || year > 2999)
-        return false;
-    if (month < 1 || month > 12)
-        return false;
-    if (day < 1 || day > 31)
-        return false;
-    
-    return true;
+    return DateKey::parse(date, len, key);
 }
 
 /**
  * Helper: Validate and parse value
  * Rules:
- * - Must be a valid number (int or float)
+ * - Must be a valid number (int or float), as accepted by strtof
  * - Must be positive
  * - Must be between 0 and 1000
+ * 
+ * If the text is not a number, value is set to 0 so the caller
+ * reports "bad input" rather than a range error
  */
-bool BitcoinExchange::isValidValue(const std::string& value_str, float& value)
+bool BitcoinExchange::isValidValue(const char* str, size_t len, float& value) const
 {
-    try
-    {
-        value = stringToFloat(value_str);
-    }
-    catch (const std::exception&)
+    if (!FloatParser::parse(str, len, value))
     {
+        value = 0;
         return false;
     }
     
@@ -109,239 +136,1272 @@ bool BitcoinExchange::isValidValue(const std::string& value_str, float& value)
     return true;
 }
 
+/**
+ * Remember the row an unterminated last line produced (the last entry)
+ * and what its date held before it: in earlier entries, else in the
+ * version the entries are applied to
+ */
+static void recordPendingRow(LiveIndex::Version& version,
+                             const std::vector<PriceIndex::Entry>& entries,
+                             const LiveIndex::Version* base, bool pending)
+{
+    version.hasPendingRow = pending;
+    if (!pending)
+        return;
+    
+    uint32_t key = entries.back().key;
+    version.pendingKey = key;
+    version.pendingHadRate = false;
+    for (size_t i = entries.size() - 1; i > 0; i--)
+    {
+        if (entries[i - 1].key == key)
+        {
+            version.pendingHadRate = true;
+            version.pendingOldRate = entries[i - 1].rate;
+            return;
+        }
+    }
+    if (!base)
+        return;
+    if (base->hasPendingRow && base->pendingKey == key)
+    {
+        version.pendingHadRate = base->pendingHadRate;
+        version.pendingOldRate = base->pendingOldRate;
+    }
+    else
+        version.pendingHadRate = base->index.findExact(key, version.pendingOldRate);
+}
+
+/**
+ * Parse the CSV into a new version's index
+ * Parsing is done in place on the mapped file by DatabaseLoader
+ * (same skip rules as always: header, empty, no comma, bad date/rate)
+ */
+bool BitcoinExchange::parseDatabase(const std::string& filename, LiveIndex::Version& version)
+{
+    std::vector<PriceIndex::Entry> entries;
+    bool pending;
+    
+    if (!DatabaseLoader::load(filename, 0, _threads, entries, version.sourceOffset, pending))
+        return false;
+    
+    recordPendingRow(version, entries, NULL, pending);
+    version.index.build(entries);
+    return true;
+}
+
+/**
+ * Where refreshDatabase can resume a CSV loaded from its snapshot:
+ * just past its last '\n'. A snapshot says nothing about an
+ * unterminated last line, so then 0 (the next change reloads in full).
+ */
+static size_t resumeOffset(const std::string& filename)
+{
+    MappedFile file;
+    if (!file.open(filename) || file.size() == 0 || file.data()[file.size() - 1] != '\n')
+        return 0;
+    return file.size();
+}
+
+static void recordSource(LiveIndex::Version& version, const struct stat& source)
+{
+    version.sourceDev = source.st_dev;
+    version.sourceIno = source.st_ino;
+    version.sourceSize = source.st_size;
+    version.sourceMtime = source.st_mtim;
+}
+
 /**
  * Load the Bitcoin price database from CSV file
  * Format: date,exchange_rate
+ * 
+ * Fast path: if "<filename>.snap" was written from this exact CSV
+ * (same size and mtime), load the binary snapshot instead of parsing.
+ * Otherwise parse the CSV and refresh the snapshot (best effort: a
+ * read-only directory just means no snapshot).
+ * 
+ * The result is published as a new version of _database.
  */
 bool BitcoinExchange::loadDatabase(const std::string& filename)
 {
-    std::ifstream file(filename.c_str());
+    struct stat source;
+    bool regular = (stat(filename.c_str(), &source) == 0 && S_ISREG(source.st_mode));
+    std::string snapshot = Snapshot::pathFor(filename);
+    LiveIndex::Version* next = new LiveIndex::Version();
+    BTC_STATS_ONLY(RunStats::Clock clock;)
+    
+    next->index.setDenseLookup(_dense);
+    if (regular)
+        recordSource(*next, source);
     
-    if (!file.is_open())
+    if (_useSnapshot && regular && Snapshot::read(snapshot, source, next->index))
+        next->sourceOffset = resumeOffset(filename);
+    else if (parseDatabase(filename, *next))
     {
+        if (_useSnapshot && regular)
+            Snapshot::write(snapshot, source, next->index);
+    }
+    else
+    {
+        delete next;
         std::cerr << "Error: could not open file." << std::endl;
         return false;
     }
     
-    std::string line;
-    int line_num = 0;
+    _source = filename;
+    BTC_STATS_ONLY(_stats.databaseRows = next->index.size();)
+    _database.lockWriters();
+    _database.publish(next);
+    _database.unlockWriters();
+    BTC_STATS_ONLY(clock.lap(_stats, RunStats::STAGE_LOAD);)
+    return true;
+}
+
+/**
+ * Parse the CSV and (re)write its snapshot unconditionally
+ */
+bool BitcoinExchange::rebuildSnapshot(const std::string& filename)
+{
+    struct stat source;
+    LiveIndex::Version* next = new LiveIndex::Version();
     
-    while (std::getline(file, line))
+    next->index.setDenseLookup(_dense);
+    if (stat(filename.c_str(), &source) != 0 || !parseDatabase(filename, *next))
     {
-        line_num++;
-        
-        // Skip header line
-        if (line_num == 1)
-            continue;
-        
-        // Skip empty lines
-        if (line.empty())
-            continue;
-        
-        // Find comma separator
-        size_t comma_pos = line.find(',');
-        if (comma_pos == std::string::npos)
-            continue;
-        
-        std::string date = line.substr(0, comma_pos);
-        std::string rate_str = line.substr(comma_pos + 1);
-        
-        // Trim whitespace from date
-        while (!date.empty() && std::isspace(date[date.length() - 1]))
-            date.erase(date.length() - 1);
-        while (!date.empty() && std::isspace(date[0]))
-            date = date.substr(1);
-        
-        // Trim whitespace from rate
-        while (!rate_str.empty() && std::isspace(rate_str[rate_str.length() - 1]))
-            rate_str.erase(rate_str.length() - 1);
-        while (!rate_str.empty() && std::isspace(rate_str[0]))
-            rate_str = rate_str.substr(1);
-        
-        // Validate date format
-        if (!isValidDate(date))
-            continue;
-        
-        // Parse exchange rate
-        float rate;
-        try
+        delete next;
+        std::cerr << "Error: could not open file." << std::endl;
+        return false;
+    }
+    recordSource(*next, source);
+    _source = filename;
+    _database.lockWriters();
+    _database.publish(next);
+    _database.unlockWriters();
+    
+    LiveIndex::Reader current(_database);
+    if (!Snapshot::write(Snapshot::pathFor(filename), source, current->index))
+    {
+        std::cerr << "Error: could not write snapshot." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Load the other assets' rates (see ColumnStore)
+ * Each spec is either "NAME=file.csv" (a date,rate file) or a wide
+ * "date,NAME1,NAME2,..." file. Call before processing starts.
+ */
+bool BitcoinExchange::loadAssets(const std::vector<std::string>& specs)
+{
+    ColumnStore* store = new ColumnStore();
+    BTC_STATS_ONLY(RunStats::Clock clock;)
+    
+    for (size_t i = 0; i < specs.size(); i++)
+    {
+        size_t eq = specs[i].find('=');
+        bool ok = (eq == std::string::npos)
+                  ? store->addWideCsv(specs[i])
+                  : store->addCsv(specs[i].substr(0, eq), specs[i].substr(eq + 1));
+        if (!ok)
         {
-            rate = stringToFloat(rate_str);
+            ColumnStore::release(store);
+            std::cerr << "Error: could not open file." << std::endl;
+            return false;
         }
-        catch (const std::exception&)
+    }
+    store->build();
+    
+    ColumnStore::release(_assets);
+    _assets = store;
+    BTC_STATS_ONLY(clock.lap(_stats, RunStats::STAGE_LOAD);)
+    return true;
+}
+
+/**
+ * Switch input lines to timestamps, answered from a tick database
+ * ("timestamp,rate" CSV, see TickIndex); `compact` delta-encodes the
+ * timestamps. Call before processing starts.
+ */
+bool BitcoinExchange::loadTicks(const std::string& filename, bool compact)
+{
+    TickIndex* ticks = new TickIndex();
+    BTC_STATS_ONLY(RunStats::Clock clock;)
+    
+    ticks->setCompact(compact);
+    if (!ticks->load(filename))
+    {
+        TickIndex::release(ticks);
+        std::cerr << "Error: could not open file." << std::endl;
+        return false;
+    }
+    
+    TickIndex::release(_ticks);
+    _ticks = ticks;
+    BTC_STATS_ONLY(_stats.databaseRows = ticks->size();)
+    BTC_STATS_ONLY(clock.lap(_stats, RunStats::STAGE_LOAD);)
+    return true;
+}
+
+/**
+ * Incremental reload
+ * 
+ * Compared with what the current version was loaded from:
+ * - same file, same size and mtime: nothing to do
+ * - same file, grown: parse only [sourceOffset, EOF) and merge those
+ *   rows into a copy of the index (PriceIndex::assignMerged). Rows
+ *   with old or repeated dates are corrections: they overwrite, like
+ *   a later duplicate does in a full load. A row taken from a then
+ *   unterminated last line is undone first, since that line is re-read
+ * - anything else (replaced, truncated, edited in place): full load
+ * 
+ * The new index is published as a new version. Lookups already running
+ * keep the version they started with; nobody waits for the parse.
+ */
+bool BitcoinExchange::refreshDatabase()
+{
+    if (_source.empty())
+        return false;
+    
+    struct stat source;
+    if (stat(_source.c_str(), &source) != 0 || !S_ISREG(source.st_mode))
+        return false;
+    
+    _database.lockWriters();
+    LiveIndex::Reader current(_database);
+    
+    bool same_file = (source.st_dev == current->sourceDev && source.st_ino == current->sourceIno);
+    if (same_file && source.st_size == current->sourceSize
+        && source.st_mtim.tv_sec == current->sourceMtime.tv_sec
+        && source.st_mtim.tv_nsec == current->sourceMtime.tv_nsec)
+    {
+        _database.unlockWriters();
+        return true;
+    }
+    
+    bool appended = same_file && source.st_size > current->sourceSize
+                    && current->sourceOffset > 0;
+    LiveIndex::Version* next = new LiveIndex::Version();
+    next->index.setDenseLookup(_dense);
+    recordSource(*next, source);
+    
+    bool ok;
+    if (appended)
+    {
+        std::vector<PriceIndex::Entry> updates;
+        bool pending;
+        ok = DatabaseLoader::load(_source, current->sourceOffset, _threads,
+                                  updates, next->sourceOffset, pending);
+        if (ok)
         {
-            continue;
+            recordPendingRow(*next, updates, &*current, pending);
+            const uint32_t* drop = NULL;
+            if (current->hasPendingRow)
+            {
+                drop = &current->pendingKey;
+                if (current->pendingHadRate)
+                {
+                    PriceIndex::Entry undo;
+                    undo.key = current->pendingKey;
+                    undo.rate = current->pendingOldRate;
+                    updates.insert(updates.begin(), undo);
+                }
+            }
+            next->index.assignMerged(current->index, updates, drop);
         }
-        
-        // Store in map
-        _database[date] = rate;
     }
+    else
+        ok = parseDatabase(_source, *next);
     
-    file.close();
-    return true;
+    if (ok)
+        _database.publish(next);
+    else
+        delete next;
+    _database.unlockWriters();
+    return ok;
 }
 
 /**
- * Check if exact date exists in database
+ * Number of rows (distinct dates) in the database
  */
-bool BitcoinExchange::dateExists(const std::string& date)
+size_t BitcoinExchange::size() const
 {
-    return _database.find(date) != _database.end();
+    LiveIndex::Reader current(_database);
+    return current->index.size();
 }
 
 /**
- * Get the closest lower date that exists in the database
- * Uses map's lower_bound for efficient search
+ * Get the rate of the closest lower (or equal) date in the database
  * 
  * Example:
- * Database has: 2011-01-03, 2011-01-04, 2011-01-05
- * Query: 2011-01-04 12:00 → Returns 2011-01-03 (closest lower)
+ * Database has: 2011-01-03, 2011-01-05
+ * Query: 2011-01-04 → rate of 2011-01-03 (closest lower)
+ * Query: 2011-01-05 → rate of 2011-01-05 (exact match)
+ * 
+ * Returns false if every database date is after the query
+ */
+bool BitcoinExchange::getClosestLowerRate(uint32_t key, float& rate) const
+{
+    LiveIndex::Reader current(_database);
+    return current->index.findRate(key, rate);
+}
+
+/**
+ * Batch lookup: resolve every query of the block at once
+ * 
+ * The keys go to PriceIndex::findRates, which runs their searches
+ * interleaved so the cache misses overlap; answers come back in the
+ * order of `queries`.
  */
-std::string BitcoinExchange::getClosestLowerDate(const std::string& date)
+void BitcoinExchange::resolveQueries(std::vector<Query>& queries) const
 {
-    // lower_bound returns iterator to first element >= date
-    // So we need to go back one to get the closest lower date
-    std::map<std::string, float>::iterator it = _database.lower_bound(date);
+    LiveIndex::Reader current(_database);
+    resolveQueries(current->index, queries);
+}
+
+void BitcoinExchange::resolveQueries(const PriceIndex& index, std::vector<Query>& queries) const
+{
+    size_t count = queries.size();
+    if (count == 0)
+        return;
+    
+    std::vector<uint32_t> keys(count);
+    std::vector<float> rates(count);
+    std::vector<unsigned char> found(count);
+    
+    for (size_t i = 0; i < count; i++)
+        keys[i] = queries[i].key;
     
-    // If exact match exists, use it
-    if (it != _database.end() && it->first == date)
-        return date;
+    index.findRates(&keys[0], count, &rates[0], &found[0]);
     
-    // Go back to get closest lower date
-    if (it != _database.begin())
+    for (size_t i = 0; i < count; i++)
     {
-        --it;
-        return it->first;
+        queries[i].found = (found[i] != 0);
+        queries[i].rate = found[i] ? rates[i] : 0;
+        queries[i].result = queries[i].value * queries[i].rate;
     }
-    
-    // No lower date exists in database
-    return "";
 }
 
 /**
- * Process input file and calculate Bitcoin values
+ * One line-aligned slice of the input file and the text it produces
  * 
- * Algorithm:
- * 1. Open file
- * 2. Parse each line: "date | value"
- * 3. Validate date and value
- * 4. Find exchange rate for date (use closest lower if exact not found)
- * 5. Calculate: result = value * exchange_rate
- * 6. Output result or error message
+ * Result values are always formatted in fixed/2 notation. The first
+ * result of the chunk is remembered (value + where its text sits in
+ * `out`) because the very first result of the process prints its value
+ * before std::fixed was ever set on std::cout; emitChunk patches that
+ * one in at output time.
  */
-void BitcoinExchange::processInputFile(const std::string& filename)
+struct InputChunk
+{
+    const char* begin;
+    const char* end;
+    std::string out;
+    bool hasResult;
+    float firstValue;
+    size_t firstValuePos;
+    size_t firstValueLen;
+};
+
+/**
+ * What a parsed input line turned out to be
+ */
+enum LineKind
+{
+    LINE_EMPTY,
+    LINE_BAD_INPUT,
+    LINE_NEGATIVE,
+    LINE_TOO_LARGE,
+    LINE_QUERY,
+    LINE_RANGE,
+    LINE_ASSETS,
+    LINE_TICK
+};
+
+enum RangeOp
+{
+    RANGE_MIN,
+    RANGE_MAX,
+    RANGE_AVG
+};
+
+/**
+ * One "from .. to | op" line, resolved by PriceIndex::findRange
+ */
+struct RangeQuery
+{
+    uint32_t from;
+    uint32_t to;
+    RangeOp op;
+    bool found;
+    RangeTable::Stats stats;
+};
+
+struct ParsedLine
+{
+    const char* line;
+    size_t len;
+    const char* date;
+    size_t dateLen;
+    LineKind kind;
+    BTC_STATS_ONLY(RunStats::Outcome badReason;)
+};
+
+/**
+ * One "date | value | NAME[,NAME...]" line: columns are
+ * worker.assetColumns[firstColumn .. firstColumn + columnCount)
+ */
+struct AssetQuery
+{
+    uint32_t key;
+    float value;
+    size_t firstColumn;
+    size_t columnCount;
+};
+
+/**
+ * One "timestamp | value" line (with loadTicks); query.key is unused
+ */
+struct TickQuery
+{
+    int64_t time;
+    BitcoinExchange::Query query;
+};
+
+/**
+ * Per-thread scratch space, reused from chunk to chunk
+ */
+struct InputWorker
+{
+    std::vector<ParsedLine> lines;
+    std::vector<BitcoinExchange::Query> queries;
+    std::vector<RangeQuery> ranges;
+    std::vector<AssetQuery> assets;
+    std::vector<size_t> assetColumns;
+    std::vector<TickQuery> ticks;
+    BTC_STATS_ONLY(RunStats stats;)
+};
+
+/**
+ * Shared state of one round of parallel chunk processing
+ * Workers claim chunk indexes from `next` until none are left
+ */
+struct InputRound
 {
-    std::ifstream file(filename.c_str());
+    const BitcoinExchange* exchange;
+    const PriceIndex* index;
+    std::vector<InputChunk>* chunks;
+    size_t count;
+    size_t next;
+    BTC_STATS_ONLY(RunStats* stats;)
+};
+
+/**
+ * The value of a result line, remembered if it is the chunk's first
+ * result (see InputChunk)
+ */
+static void appendResultValue(InputChunk& chunk, float value)
+{
+    size_t pos = chunk.out.size();
+    FloatFormatter::appendFixed2(chunk.out, value);
+    if (!chunk.hasResult)
+    {
+        chunk.hasResult = true;
+        chunk.firstValue = value;
+        chunk.firstValuePos = pos;
+        chunk.firstValueLen = chunk.out.size() - pos;
+    }
+}
+
+static void appendBadInput(std::string& out, const char* line, size_t len)
+{
+    out += "Error: bad input => ";
+    out.append(line, len);
+    out += '\n';
+}
+
+/**
+ * Parse and validate one input line (without its '\n')
+ * Valid "date | value" lines also get a Query in worker.queries
+ */
+void BitcoinExchange::parseLine(const char* line, size_t len, InputWorker& worker) const
+{
+    ParsedLine parsed;
+    parsed.line = line;
+    parsed.len = len;
+    parsed.date = line;
+    parsed.dateLen = 0;
+    parsed.kind = LINE_BAD_INPUT;
+    BTC_STATS_ONLY(parsed.badReason = RunStats::OUTCOME_NO_SEPARATOR;)
     
-    if (!file.is_open())
+    // Skip empty lines
+    if (len == 0)
     {
-        std::cerr << "Error: could not open file." << std::endl;
+        parsed.kind = LINE_EMPTY;
+        worker.lines.push_back(parsed);
         return;
     }
     
-    std::string line;
-    int line_num = 0;
+    // ===== PARSE LINE =====
+    // Expected format: "2011-01-03 | 3"
     
-    while (std::getline(file, line))
+    // Find pipe separator
+    const char* pipe = static_cast<const char*>(std::memchr(line, '|', len));
+    if (!pipe)
     {
-        line_num++;
-        
-        // Skip header line
-        if (line_num == 1 && line == "date | value")
-            continue;
+        worker.lines.push_back(parsed);
+        return;
+    }
+    
+    // Split by pipe and trim whitespace from both parts
+    const char* date_begin = line;
+    const char* date_end = pipe;
+    const char* value_begin = pipe + 1;
+    const char* value_end = line + len;
+    Helpers::trim(date_begin, date_end);
+    Helpers::trim(value_begin, value_end);
+    parsed.date = date_begin;
+    parsed.dateLen = static_cast<size_t>(date_end - date_begin);
+    
+    // ===== ASSET LIST ("date | value | ETH,LTC", with loadAssets) =====
+    const char* assets_begin = NULL;
+    const char* assets_end = NULL;
+    if (_assets)
+    {
+        const char* pipe2 = static_cast<const char*>(
+            std::memchr(value_begin, '|', static_cast<size_t>(value_end - value_begin)));
+        if (pipe2)
+        {
+            assets_begin = pipe2 + 1;
+            assets_end = value_end;
+            value_end = pipe2;
+            Helpers::trim(value_begin, value_end);
+            Helpers::trim(assets_begin, assets_end);
+        }
+    }
+    
+    // ===== TIMESTAMP ("2011-01-03T10:00:00.250 | 3", with loadTicks) =====
+    // Ticks are BTC rates: a line naming assets has no tick to price it
+    if (_ticks)
+    {
+        if (assets_begin)
+            worker.lines.push_back(parsed);
+        else
+            parseTickLine(parsed, value_begin, value_end, worker);
+        return;
+    }
+    
+    // ===== RANGE QUERY ("from .. to | op") =====
+    if (parsed.dateLen > 10 && !assets_begin
+        && parseRangeLine(parsed.date, parsed.dateLen, value_begin,
+                          static_cast<size_t>(value_end - value_begin), worker))
+    {
+        parsed.kind = LINE_RANGE;
+        worker.lines.push_back(parsed);
+        return;
+    }
+    
+    // ===== VALIDATE DATE =====
+    Query query;
+    BTC_STATS_ONLY(parsed.badReason = RunStats::OUTCOME_BAD_DATE;)
+    if (!isValidDate(parsed.date, parsed.dateLen, query.key))
+    {
+        worker.lines.push_back(parsed);
+        return;
+    }
+    
+    // ===== VALIDATE AND PARSE VALUE =====
+    BTC_STATS_ONLY(parsed.badReason = RunStats::OUTCOME_BAD_VALUE;)
+    if (!isValidValue(value_begin, static_cast<size_t>(value_end - value_begin), query.value))
+    {
+        // Determine which error to report
+        if (query.value < 0)
+            parsed.kind = LINE_NEGATIVE;
+        else if (query.value > 1000)
+            parsed.kind = LINE_TOO_LARGE;
+        worker.lines.push_back(parsed);
+        return;
+    }
+    
+    if (assets_begin)
+    {
+        BTC_STATS_ONLY(parsed.badReason = RunStats::OUTCOME_BAD_ASSETS;)
+        if (parseAssetList(assets_begin, assets_end, query, worker))
+            parsed.kind = LINE_ASSETS;
+        worker.lines.push_back(parsed);
+        return;
+    }
+    
+    parsed.kind = LINE_QUERY;
+    worker.lines.push_back(parsed);
+    worker.queries.push_back(query);
+}
+
+/**
+ * Tick mode: validate the timestamp and value like a date line
+ * Valid lines get a TickQuery in worker.ticks
+ */
+void BitcoinExchange::parseTickLine(ParsedLine& parsed, const char* value_begin,
+                                    const char* value_end, InputWorker& worker) const
+{
+    TickQuery tick;
+    
+    BTC_STATS_ONLY(parsed.badReason = RunStats::OUTCOME_BAD_DATE;)
+    if (!Timestamp::parse(parsed.date, parsed.dateLen, tick.time))
+    {
+        worker.lines.push_back(parsed);
+        return;
+    }
+    BTC_STATS_ONLY(parsed.badReason = RunStats::OUTCOME_BAD_VALUE;)
+    if (!isValidValue(value_begin, static_cast<size_t>(value_end - value_begin), tick.query.value))
+    {
+        if (tick.query.value < 0)
+            parsed.kind = LINE_NEGATIVE;
+        else if (tick.query.value > 1000)
+            parsed.kind = LINE_TOO_LARGE;
+        worker.lines.push_back(parsed);
+        return;
+    }
+    
+    tick.query.key = 0;
+    parsed.kind = LINE_TICK;
+    worker.lines.push_back(parsed);
+    worker.ticks.push_back(tick);
+}
+
+/**
+ * Resolve "NAME[,NAME...]" to ColumnStore columns
+ * Any unknown or empty name makes the whole line bad input
+ */
+bool BitcoinExchange::parseAssetList(const char* begin, const char* end,
+                                     const Query& query, InputWorker& worker) const
+{
+    AssetQuery asset;
+    asset.key = query.key;
+    asset.value = query.value;
+    asset.firstColumn = worker.assetColumns.size();
+    asset.columnCount = 0;
+    
+    for (const char* name = begin; name <= end; asset.columnCount++)
+    {
+        const char* comma = static_cast<const char*>(
+            std::memchr(name, ',', static_cast<size_t>(end - name)));
+        const char* name_end = comma ? comma : end;
+        const char* name_begin = name;
+        Helpers::trim(name_begin, name_end);
+        size_t column = _assets->findColumn(name_begin, static_cast<size_t>(name_end - name_begin));
+        if (column == ColumnStore::NOT_FOUND)
+        {
+            worker.assetColumns.resize(asset.firstColumn);
+            return false;
+        }
+        worker.assetColumns.push_back(column);
+        name = (comma ? comma : end) + 1;
+    }
+    worker.assets.push_back(asset);
+    return true;
+}
+
+/**
+ * Parse "from .. to" and "min" / "max" / "avg" (both fields trimmed)
+ * Valid lines get a RangeQuery in worker.ranges
+ */
+bool BitcoinExchange::parseRangeLine(const char* field, size_t field_len, const char* op,
+                                     size_t op_len, InputWorker& worker) const
+{
+    const char* field_end = field + field_len;
+    const char* dots = NULL;
+    for (const char* p = field; p + 1 < field_end; p++)
+    {
+        if (p[0] == '.' && p[1] == '.')
+        {
+            dots = p;
+            break;
+        }
+    }
+    if (!dots)
+        return false;
+    
+    const char* from_begin = field;
+    const char* from_end = dots;
+    const char* to_begin = dots + 2;
+    const char* to_end = field_end;
+    Helpers::trim(from_begin, from_end);
+    Helpers::trim(to_begin, to_end);
+    
+    RangeQuery range;
+    if (op_len != 3)
+        return false;
+    if (std::memcmp(op, "min", 3) == 0)
+        range.op = RANGE_MIN;
+    else if (std::memcmp(op, "max", 3) == 0)
+        range.op = RANGE_MAX;
+    else if (std::memcmp(op, "avg", 3) == 0)
+        range.op = RANGE_AVG;
+    else
+        return false;
+    
+    if (!isValidDate(from_begin, static_cast<size_t>(from_end - from_begin), range.from)
+        || !isValidDate(to_begin, static_cast<size_t>(to_end - to_begin), range.to)
+        || range.from > range.to)
+        return false;
+    
+    range.found = false;
+    worker.ranges.push_back(range);
+    return true;
+}
+
+/**
+ * Append the output of one parsed line to chunk.out
+ * Numbers go through FloatFormatter (same text as fixed/2 iostream)
+ */
+void BitcoinExchange::formatLine(const ParsedLine& parsed, const Query* query,
+                                 InputChunk& chunk) const
+{
+    switch (parsed.kind)
+    {
+        case LINE_EMPTY:
+            return;
+        case LINE_BAD_INPUT:
+            appendBadInput(chunk.out, parsed.line, parsed.len);
+            return;
+        case LINE_NEGATIVE:
+            chunk.out += "Error: not a positive number.\n";
+            return;
+        case LINE_TOO_LARGE:
+            chunk.out += "Error: too large a number.\n";
+            return;
+        case LINE_QUERY:
+        case LINE_RANGE:
+        case LINE_ASSETS:
+        case LINE_TICK:
+            break;
+    }
+    
+    // ===== FIND EXCHANGE RATE =====
+    if (!query->found)
+    {
+        chunk.out += "Error: no exchange rate available for ";
+        chunk.out.append(parsed.date, parsed.dateLen);
+        chunk.out += '\n';
+        return;
+    }
+    
+    // ===== OUTPUT =====
+    // Format output: "2011-01-03 => 3 = 0.90"
+    chunk.out.append(parsed.date, parsed.dateLen);
+    chunk.out += " => ";
+    appendResultValue(chunk, query->value);
+    chunk.out += " = ";
+    FloatFormatter::appendFixed2(chunk.out, query->result);
+    chunk.out += '\n';
+}
+
+/**
+ * Output of a range line: "2011-01-03 .. 2011-12-31 => min = 0.30"
+ */
+void BitcoinExchange::formatRange(const ParsedLine& parsed, const RangeQuery& range,
+                                  InputChunk& chunk) const
+{
+    if (!range.found)
+    {
+        chunk.out += "Error: no exchange rate available for ";
+        chunk.out.append(parsed.date, parsed.dateLen);
+        chunk.out += '\n';
+        return;
+    }
+    
+    chunk.out.append(parsed.date, parsed.dateLen);
+    switch (range.op)
+    {
+        case RANGE_MIN:
+            chunk.out += " => min = ";
+            FloatFormatter::appendFixed2(chunk.out, range.stats.min);
+            break;
+        case RANGE_MAX:
+            chunk.out += " => max = ";
+            FloatFormatter::appendFixed2(chunk.out, range.stats.max);
+            break;
+        case RANGE_AVG:
+            chunk.out += " => avg = ";
+            FloatFormatter::appendFixed2(chunk.out,
+                static_cast<float>(range.stats.sum / static_cast<double>(range.stats.count)));
+            break;
+    }
+    chunk.out += '\n';
+}
+
+/**
+ * Output of an asset line: one row search, then one line per asset
+ *   2011-01-03 => 3.00 ETH = 36.00
+ * Returns whether any asset had a rate
+ */
+bool BitcoinExchange::formatAssets(const ParsedLine& parsed, const AssetQuery& asset,
+                                   const InputWorker& worker, InputChunk& chunk) const
+{
+    size_t row = 0;
+    bool found_row = _assets->findRow(asset.key, row);
+    bool found = false;
+    
+    for (size_t i = 0; i < asset.columnCount; i++)
+    {
+        size_t column = worker.assetColumns[asset.firstColumn + i];
+        const std::string& name = _assets->name(column);
+        float rate;
         
-        // Skip empty lines
-        if (line.empty())
+        if (!found_row || !_assets->rate(row, column, rate))
+        {
+            chunk.out += "Error: no exchange rate available for ";
+            chunk.out.append(parsed.date, parsed.dateLen);
+            chunk.out += ' ';
+            chunk.out += name;
+            chunk.out += '\n';
             continue;
+        }
+        chunk.out.append(parsed.date, parsed.dateLen);
+        chunk.out += " => ";
+        appendResultValue(chunk, asset.value);
+        chunk.out += ' ';
+        chunk.out += name;
+        chunk.out += " = ";
+        FloatFormatter::appendFixed2(chunk.out, asset.value * rate);
+        chunk.out += '\n';
+        found = true;
+    }
+    return found;
+}
+
+#ifdef BTC_STATS
+/**
+ * --stats category of a formatted line (found: its lookup succeeded)
+ */
+static RunStats::Outcome lineOutcome(const ParsedLine& parsed, bool found)
+{
+    switch (parsed.kind)
+    {
+        case LINE_EMPTY:
+            return RunStats::OUTCOME_EMPTY;
+        case LINE_BAD_INPUT:
+            return parsed.badReason;
+        case LINE_NEGATIVE:
+            return RunStats::OUTCOME_NEGATIVE;
+        case LINE_TOO_LARGE:
+            return RunStats::OUTCOME_TOO_LARGE;
+        default:
+            return found ? RunStats::OUTCOME_RESULT : RunStats::OUTCOME_NO_RATE;
+    }
+}
+#endif
+
+/**
+ * Three passes over a chunk:
+ * 1. Parse and validate every line, collecting the lookups
+ * 2. Resolve all lookups in one batch (resolveQueries), and the range
+ *    queries one by one (O(log n) each)
+ * 3. Format every line in its original order
+ */
+void BitcoinExchange::processChunk(InputChunk& chunk, InputWorker& worker,
+                                   const PriceIndex& index) const
+{
+    const char* begin = chunk.begin;
+    BTC_STATS_ONLY(RunStats::Clock clock;)
+    worker.lines.clear();
+    worker.queries.clear();
+    worker.ranges.clear();
+    worker.assets.clear();
+    worker.assetColumns.clear();
+    worker.ticks.clear();
+    
+    while (begin < chunk.end)
+    {
+        const char* nl = static_cast<const char*>(
+            std::memchr(begin, '\n', static_cast<size_t>(chunk.end - begin)));
+        const char* line_end = nl ? nl : chunk.end;
         
-        // ===== PARSE LINE =====
-        // Expected format: "2011-01-03 | 3"
-        
-        // Find pipe separator
-        size_t pipe_pos = line.find('|');
-        if (pipe_pos == std::string::npos)
+        parseLine(begin, static_cast<size_t>(line_end - begin), worker);
+        begin = line_end + 1;
+    }
+    BTC_STATS_ONLY(clock.lap(worker.stats, RunStats::STAGE_PARSE);)
+    
+    resolveQueries(index, worker.queries);
+    for (size_t i = 0; i < worker.ranges.size(); i++)
+    {
+        RangeQuery& range = worker.ranges[i];
+        range.found = index.findRange(range.from, range.to, range.stats);
+    }
+    for (size_t i = 0; i < worker.ticks.size(); i++)
+    {
+        Query& query = worker.ticks[i].query;
+        query.found = _ticks->findRate(worker.ticks[i].time, query.rate);
+        query.result = query.found ? query.value * query.rate : 0;
+    }
+    BTC_STATS_ONLY(clock.lap(worker.stats, RunStats::STAGE_LOOKUP);)
+    BTC_STATS_ONLY(worker.stats.lookups += worker.queries.size() + worker.ranges.size()
+                                           + worker.assets.size() + worker.ticks.size();)
+    
+    size_t q = 0;
+    size_t r = 0;
+    size_t a = 0;
+    size_t t = 0;
+    for (size_t i = 0; i < worker.lines.size(); i++)
+    {
+        const ParsedLine& parsed = worker.lines[i];
+        if (parsed.kind == LINE_RANGE)
         {
-            std::cout << "Error: bad input => " << line << std::endl;
+            BTC_STATS_ONLY(worker.stats.add(lineOutcome(parsed, worker.ranges[r].found));)
+            formatRange(parsed, worker.ranges[r++], chunk);
             continue;
         }
-        
-        // Split by pipe
-        std::string date_part = line.substr(0, pipe_pos);
-        std::string value_part = line.substr(pipe_pos + 1);
-        
-        // Trim whitespace from both parts
-        // Remove trailing spaces from date
-        while (!date_part.empty() && std::isspace(date_part[date_part.length() - 1]))
-            date_part.erase(date_part.length() - 1);
-        // Remove leading spaces from date
-        while (!date_part.empty() && std::isspace(date_part[0]))
-            date_part = date_part.substr(1);
-        
-        // Remove trailing spaces from value
-        while (!value_part.empty() && std::isspace(value_part[value_part.length() - 1]))
-            value_part.erase(value_part.length() - 1);
-        // Remove leading spaces from value
-        while (!value_part.empty() && std::isspace(value_part[0]))
-            value_part = value_part.substr(1);
-        
-        // ===== VALIDATE DATE =====
-        if (!isValidDate(date_part))
+        if (parsed.kind == LINE_ASSETS)
         {
-            std::cout << "Error: bad input => " << line << std::endl;
+            bool found = formatAssets(parsed, worker.assets[a++], worker, chunk);
+            BTC_STATS_ONLY(worker.stats.add(lineOutcome(parsed, found));)
+            (void)found;
             continue;
         }
-        
-        // ===== VALIDATE AND PARSE VALUE =====
-        float value;
-        if (!isValidValue(value_part, value))
+        const Query* query = NULL;
+        if (parsed.kind == LINE_QUERY)
+            query = &worker.queries[q++];
+        else if (parsed.kind == LINE_TICK)
+            query = &worker.ticks[t++].query;
+        BTC_STATS_ONLY(worker.stats.add(lineOutcome(parsed, query && query->found));)
+        formatLine(parsed, query, chunk);
+    }
+    BTC_STATS_ONLY(clock.lap(worker.stats, RunStats::STAGE_FORMAT);)
+    BTC_STATS_ONLY(worker.stats.chunks++;)
+}
+
+void* BitcoinExchange::processChunksThread(void* arg)
+{
+    InputRound* round = static_cast<InputRound*>(arg);
+    InputWorker worker;
+    
+    for (;;)
+    {
+        size_t i = __sync_fetch_and_add(&round->next, 1);
+        if (i >= round->count)
+            break;
+        round->exchange->processChunk((*round->chunks)[i], worker, *round->index);
+    }
+    BTC_STATS_ONLY(round->stats->merge(worker.stats);)
+    return NULL;
+}
+
+/**
+ * Write a processed chunk to std::cout
+ * 
+ * The original loop wrote `std::cout << value` and only then switched
+ * std::cout to fixed/2 for the result, so the first result ever printed
+ * shows its value in the stream's default notation ("3", not "3.00").
+ * That is reproduced here against the real stream state.
+ */
+void BitcoinExchange::emitChunk(const InputChunk& chunk) const
+{
+    bool fixed2 = (std::cout.flags() & std::ios::fixed) && std::cout.precision() == 2;
+    
+    if (chunk.hasResult && !fixed2)
+    {
+        size_t rest = chunk.firstValuePos + chunk.firstValueLen;
+        std::cout.write(chunk.out.data(), static_cast<std::streamsize>(chunk.firstValuePos));
+        std::cout << chunk.firstValue << std::fixed << std::setprecision(2);
+        std::cout.write(chunk.out.data() + rest, static_cast<std::streamsize>(chunk.out.size() - rest));
+    }
+    else
+        std::cout.write(chunk.out.data(), static_cast<std::streamsize>(chunk.out.size()));
+}
+
+/**
+ * Process input file and calculate Bitcoin values
+ * 
+ * Algorithm:
+ * 1. Open (map) file
+ * 2. Cut it into line-aligned chunks of ~CHUNK_BYTES
+ * 3. For each chunk: parse and validate every "date | value" line,
+ *    find all exchange rates in one batch (closest lower date),
+ *    then format results and errors in line order
+ * 4. Output chunks in file order
+ * 
+ * Output is never flushed per line: each chunk's text is built in a
+ * buffer that is reused for the whole run, written with one call, and
+ * std::cout is flushed once at the end.
+ * 
+ * With several threads, chunks are processed in rounds of
+ * CHUNKS_PER_THREAD * threads chunks by a pool of workers sharing the
+ * read-only database; each round is written out in order before the
+ * next starts, so stdout is byte-identical to the serial run and
+ * memory stays bounded.
+ * 
+ * The whole file is answered from the database version current when it
+ * starts, even if refreshDatabase publishes a new one meanwhile.
+ */
+void BitcoinExchange::processInputFile(const std::string& filename)
+{
+    if (filename == "-")
+    {
+        processInputStream(0);
+        return;
+    }
+    
+    // Pipes, FIFOs, terminals and sockets are read as a stream, not
+    // slurped; anything else (directories included) goes the file way
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0
+        && (S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode) || S_ISSOCK(st.st_mode)))
+    {
+        processInputStream(fd);
+        ::close(fd);
+        return;
+    }
+    if (fd >= 0)
+        ::close(fd);
+    
+    MappedFile file;
+    BTC_STATS_ONLY(RunStats::Clock clock;)
+    BTC_STATS_ONLY(uint64_t start = RunStats::nowNanos();)
+    
+    if (!file.open(filename))
+    {
+        std::cerr << "Error: could not open file." << std::endl;
+        return;
+    }
+    BTC_STATS_ONLY(clock.lap(_stats, RunStats::STAGE_OPEN);)
+    BTC_STATS_ONLY(_stats.bytesIn += file.size();)
+    
+    const char* begin = skipHeader(file.data(), file.data() + file.size());
+    std::vector<InputChunk> chunks;
+    LiveIndex::Reader current(_database);
+    
+    processText(begin, file.data() + file.size(), chunks, current->index);
+    std::cout.flush();
+    BTC_STATS_ONLY(_stats.stageNanos[RunStats::STAGE_TOTAL] += RunStats::nowNanos() - start;)
+}
+
+/**
+ * Skip the header line (only if it is exactly "date | value")
+ * [begin, end) must hold the whole first line
+ */
+const char* BitcoinExchange::skipHeader(const char* begin, const char* end)
+{
+    if (begin < end)
+    {
+        const char* nl = static_cast<const char*>(
+            std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+        const char* line_end = nl ? nl : end;
+        std::string header = "date | value";
+        if (static_cast<size_t>(line_end - begin) == header.length()
+            && std::memcmp(begin, header.data(), header.length()) == 0)
+            begin = nl ? nl + 1 : end;
+    }
+    return begin;
+}
+
+/**
+ * Steps 2-4 of processInputFile for the whole lines in [begin, end)
+ * `chunks` is the caller's round buffer, kept from call to call
+ */
+void BitcoinExchange::processText(const char* begin, const char* end,
+                                  std::vector<InputChunk>& chunks,
+                                  const PriceIndex& index)
+{
+    size_t round_size = (_threads > 1) ? _threads * CHUNKS_PER_THREAD : 1;
+    size_t used = 0;
+    std::vector<pthread_t> tids(_threads);
+    std::vector<bool> started(_threads);
+    
+    if (chunks.size() < round_size)
+        chunks.resize(round_size);
+    
+    while (begin < end)
+    {
+        // Cut the next round of chunks (buffers keep their capacity)
+        used = 0;
+        while (begin < end && used < round_size)
         {
-            // Determine which error to report
-            if (value < 0)
-            {
-                std::cout << "Error: not a positive number." << std::endl;
-            }
-            else if (value > 1000)
-            {
-                std::cout << "Error: too large a number." << std::endl;
-            }
-            else
+            const char* cut = end;
+            if (static_cast<size_t>(end - begin) > CHUNK_BYTES)
             {
-                std::cout << "Error: bad input => " << line << std::endl;
+                const char* nl = static_cast<const char*>(
+                    std::memchr(begin + CHUNK_BYTES, '\n',
+                                static_cast<size_t>(end - begin) - CHUNK_BYTES));
+                cut = nl ? nl + 1 : end;
             }
-            continue;
+            InputChunk& chunk = chunks[used++];
+            chunk.begin = begin;
+            chunk.end = cut;
+            chunk.out.clear();
+            chunk.hasResult = false;
+            chunk.firstValue = 0;
+            chunk.firstValuePos = 0;
+            chunk.firstValueLen = 0;
+            begin = cut;
         }
         
-        // ===== FIND EXCHANGE RATE =====
-        std::string lookup_date = getClosestLowerDate(date_part);
+        // Process it: the calling thread works too
+        InputRound round;
+        round.exchange = this;
+        round.index = &index;
+        round.chunks = &chunks;
+        round.count = used;
+        round.next = 0;
+        BTC_STATS_ONLY(round.stats = &_stats;)
         
-        if (lookup_date.empty())
+        size_t workers = std::min(_threads, used);
+        for (size_t i = 1; i < workers; i++)
+            started[i] = (pthread_create(&tids[i], NULL, processChunksThread, &round) == 0);
+        processChunksThread(&round);
+        for (size_t i = 1; i < workers; i++)
         {
-            std::cout << "Error: no exchange rate available for " << date_part << std::endl;
-            continue;
+            if (started[i])
+                pthread_join(tids[i], NULL);
         }
         
-        float exchange_rate = _database[lookup_date];
+        // Output in file order
+        BTC_STATS_ONLY(RunStats::Clock clock;)
+        for (size_t i = 0; i < used; i++)
+        {
+            emitChunk(chunks[i]);
+            BTC_STATS_ONLY(_stats.bytesOut += chunks[i].out.size();)
+        }
+        BTC_STATS_ONLY(clock.lap(_stats, RunStats::STAGE_OUTPUT);)
+    }
+}
+
+/**
+ * Streaming input: process an unbounded pipe or FIFO in constant memory
+ * 
+ * The input goes through one STREAM_BUFFER_BYTES buffer used as a ring
+ * that is kept linear: each read() fills the free space after the
+ * carried-over bytes, every complete line is processed and written out
+ * (processText, same chunking and threads as file mode), and the
+ * unfinished last line is moved to the front to be completed by the
+ * next read. read() returns as soon as the writer has produced
+ * something, so results follow their input with at most one read of
+ * delay, while a fast producer still fills the buffer in large blocks.
+ * 
+ * The header and every message match processInputFile. A line too long
+ * to fit the buffer cannot be a valid query; it is reported as bad
+ * input and echoed while it is skipped.
+ */
+void BitcoinExchange::processInputStream(int fd)
+{
+    std::vector<char> ring(STREAM_BUFFER_BYTES);
+    std::vector<InputChunk> chunks;
+    LiveIndex::Reader current(_database);
+    size_t used = 0;
+    bool header = true;
+    bool overlong = false;
+    bool eof = false;
+    BTC_STATS_ONLY(uint64_t start = RunStats::nowNanos();)
+    
+    while (!eof)
+    {
+        BTC_STATS_ONLY(RunStats::Clock clock;)
+        ssize_t n = ::read(fd, &ring[used], ring.size() - used);
+        BTC_STATS_ONLY(clock.lap(_stats, RunStats::STAGE_OPEN);)
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            std::cerr << "Error: could not read input." << std::endl;
+            break;
+        }
+        eof = (n == 0);
+        used += static_cast<size_t>(n);
+        BTC_STATS_ONLY(_stats.bytesIn += static_cast<size_t>(n);)
         
-        // ===== CALCULATE AND OUTPUT =====
-        float result = value * exchange_rate;
+        const char* begin = &ring[0];
+        const char* end = begin + used;
+        const char* nl = Helpers::lastNewline(begin, used);
+        const char* complete = eof ? end : (nl ? nl + 1 : begin);
         
-        // Format output: "2011-01-03 => 3 = 0.9"
-        // Use fixed precision for display
-        std::cout << date_part << " => " << value;
+        // Rest of a line that did not fit: echo it up to its newline
+        if (overlong)
+        {
+            const char* stop = static_cast<const char*>(std::memchr(begin, '\n', used));
+            const char* cut = stop ? stop : end;
+            std::cout.write(begin, static_cast<std::streamsize>(cut - begin));
+            if (!stop && !eof)
+            {
+                used = 0;
+                continue;
+            }
+            std::cout << '\n';
+            overlong = false;
+            begin = stop ? stop + 1 : end;
+            header = false;
+        }
         
-        // Handle integer display (no decimal if whole number)
-        if (value == static_cast<int>(value))
+        if (header && complete > begin)
         {
-            std::cout << " = ";
+            begin = skipHeader(begin, complete);
+            header = false;
         }
-        else
+        if (complete > begin)
         {
-            std::cout << " = ";
+            processText(begin, complete, chunks, current->index);
+            std::cout.flush();
         }
         
-        // Display result with appropriate precision
-        std::cout << std::fixed << std::setprecision(2) << result << std::endl;
+        // Carry the unfinished line over; a full buffer without a
+        // newline is one line longer than the buffer
+        used = static_cast<size_t>(end - std::max(begin, complete));
+        std::memmove(&ring[0], end - used, used);
+        if (used == ring.size())
+        {
+            std::cout << "Error: bad input => ";
+            std::cout.write(&ring[0], static_cast<std::streamsize>(used));
+            overlong = true;
+            header = false;
+            used = 0;
+        }
     }
+    std::cout.flush();
+    BTC_STATS_ONLY(_stats.stageNanos[RunStats::STAGE_TOTAL] += RunStats::nowNanos() - start;)
+}
+
+/**
+ * Write the --stats summary of everything loaded and processed so far
+ */
+void BitcoinExchange::printStats(std::ostream& out, bool json) const
+{
+#ifdef BTC_STATS
+    _stats.print(out, json);
+#else
+    (void)json;
+    out << "Error: built without stats (make STATS=1)." << std::endl;
+#endif
+}
+
+/**
+ * Process the complete lines in [begin, end) of an input stream and
+ * append the text processInputFile would print for them to out
+ * 
+ * `fresh` is true while the stream has not printed any result yet: the
+ * first result then shows its value in default stream notation ("3"),
+ * exactly like the first result of processInputFile. It is cleared
+ * once that happens. Header handling is left to the caller.
+ */
+void BitcoinExchange::processLines(const char* begin, const char* end,
+                                   std::string& out, bool& fresh) const
+{
+    InputChunk chunk;
+    InputWorker worker;
+    chunk.begin = begin;
+    chunk.end = end;
+    chunk.hasResult = false;
+    chunk.firstValue = 0;
+    chunk.firstValuePos = 0;
+    chunk.firstValueLen = 0;
+    chunk.out.swap(out);
+    LiveIndex::Reader current(_database);
+    processChunk(chunk, worker, current->index);
+    chunk.out.swap(out);
     
-    file.close();
-}
\ No newline at end of file
+    if (!fresh || !chunk.hasResult)
+        return;
+    
+    std::ostringstream value;
+    value << chunk.firstValue;
+    out.replace(chunk.firstValuePos, chunk.firstValueLen, value.str());
+    fresh = false;
+}
@@ -2,12 +2,24 @@
 #define BITCOIN_EXCHANGE_HPP
 
 #include <string>
-#include <map>
+#include <vector>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
 #include <iomanip>
+#include "DateKey.hpp"
+#include "PriceIndex.hpp"
+#include "LiveIndex.hpp"
+#include "RunStats.hpp"
+
+struct InputChunk;
+struct InputWorker;
+struct ParsedLine;
+struct RangeQuery;
+struct AssetQuery;
+class ColumnStore;
+class TickIndex;
 
 /**
  * BitcoinExchange class handles:
@@ -18,20 +30,88 @@
  */
 class BitcoinExchange
 {
+public:
+    // Input is processed in line-aligned chunks of about this size
+    static const size_t CHUNK_BYTES = 1 << 20;
+    // Chunks handed out per worker thread in each parallel round
+    static const size_t CHUNKS_PER_THREAD = 4;
+    // Fixed read buffer of processInputStream (whole lines must fit)
+    static const size_t STREAM_BUFFER_BYTES = 1 << 22;
+    
+    /**
+     * One parsed "date | value" query for resolveQueries
+     */
+    struct Query
+    {
+        uint32_t key;       // DateKey day number
+        float value;
+        bool found;         // out: some date <= key has a rate
+        float rate;         // out: rate of the closest lower date
+        float result;       // out: value * rate
+    };
+
 private:
-    // Database: Date (YYYY-MM-DD) -> Exchange Rate (BTC value in some currency)
-    // Using std::map because:
-    // - Keys are automatically sorted
-    // - lower_bound() allows efficient finding of closest lower date
-    // - O(log n) lookup time
-    std::map<std::string, float> _database;
+    // Database: Date (as DateKey day number) -> Exchange Rate
+    // Using PriceIndex because:
+    // - Keys are sorted once at load time, then never change
+    // - 8 bytes per row in two contiguous arrays (no nodes, no strings)
+    // - O(log n) branchless search for the closest lower date
+    // held in a LiveIndex, so refreshDatabase can publish a new version
+    // while lookups on other threads keep reading the old one.
+    // Copies of the object share the immutable version (O(1) copy);
+    // loading, refreshing or toggling dense mode publishes a new one
+    LiveIndex _database;
+    
+    // CSV the database was loaded from (for refreshDatabase)
+    std::string _source;
+    
+    // Worker threads for loading and processing (1 = serial)
+    size_t _threads;
+    
+    // Use "<csv>.snap" binary snapshots in loadDatabase
+    bool _useSnapshot;
+    
+    // Build every version with PriceIndex's calendar table
+    bool _dense;
+    
+    // Other assets' rates (loadAssets), shared by copies; NULL if none
+    const ColumnStore* _assets;
+    
+    // Tick database (loadTicks): input is then timestamped; NULL if none
+    const TickIndex* _ticks;
+    
+    // Counters and timers for --stats (BTC_STATS builds only)
+    BTC_STATS_ONLY(RunStats _stats;)
     
     // Private helper methods
-    bool isValidDate(const std::string& date);
-    bool isValidValue(const std::string& value_str, float& value);
-    float stringToFloat(const std::string& str);
-    bool dateExists(const std::string& date);
-    std::string getClosestLowerDate(const std::string& date);
+    bool parseDatabase(const std::string& filename, LiveIndex::Version& version);
+    void publishCopy(const LiveIndex::Version& from);
+    bool isValidDate(const char* date, size_t len, uint32_t& key) const;
+    bool isValidValue(const char* str, size_t len, float& value) const;
+    bool getClosestLowerRate(uint32_t key, float& rate) const;
+    void resolveQueries(const PriceIndex& index, std::vector<Query>& queries) const;
+    
+    // Input processing (see processInputFile)
+    void parseLine(const char* line, size_t len, InputWorker& worker) const;
+    bool parseRangeLine(const char* field, size_t field_len, const char* op,
+                        size_t op_len, InputWorker& worker) const;
+    void formatLine(const ParsedLine& parsed, const Query* query,
+                    InputChunk& chunk) const;
+    void formatRange(const ParsedLine& parsed, const RangeQuery& range,
+                     InputChunk& chunk) const;
+    void parseTickLine(ParsedLine& parsed, const char* value_begin,
+                       const char* value_end, InputWorker& worker) const;
+    bool parseAssetList(const char* begin, const char* end, const Query& query,
+                        InputWorker& worker) const;
+    bool formatAssets(const ParsedLine& parsed, const AssetQuery& asset,
+                      const InputWorker& worker, InputChunk& chunk) const;
+    void processChunk(InputChunk& chunk, InputWorker& worker,
+                      const PriceIndex& index) const;
+    void emitChunk(const InputChunk& chunk) const;
+    void processText(const char* begin, const char* end,
+                     std::vector<InputChunk>& chunks, const PriceIndex& index);
+    static const char* skipHeader(const char* begin, const char* end);
+    static void* processChunksThread(void* arg);
 
 public:
     BitcoinExchange();
@@ -39,6 +119,10 @@ public:
     BitcoinExchange& operator=(const BitcoinExchange& other);
     ~BitcoinExchange();
     
+    void setThreadCount(size_t threads);
+    void setSnapshotEnabled(bool enabled);
+    void setDenseLookup(bool enabled);
+    
     /**
      * Load database from CSV file (data.csv provided with subject)
      * Format: date,exchange_rate
@@ -48,14 +132,78 @@ public:
      */
     bool loadDatabase(const std::string& filename);
     
+    /**
+     * Parse the CSV and write "<filename>.snap" even if it is fresh
+     */
+    bool rebuildSnapshot(const std::string& filename);
+    
+    /**
+     * Pick up rows appended to the CSV since it was loaded
+     * Only the new tail is parsed; a rewritten, truncated or replaced
+     * file is loaded again in full. Safe to call while other threads
+     * run lookups (see BitcoinExchange.cpp).
+     * Returns false if the file cannot be read (the old data stays)
+     */
+    bool refreshDatabase();
+    
+    /**
+     * Load rates of other assets against the same calendar
+     * ("NAME=file.csv" or a wide "date,NAME1,NAME2,..." file per spec)
+     * Input lines can then name them: "2011-01-03 | 3 | ETH,LTC"
+     */
+    bool loadAssets(const std::vector<std::string>& specs);
+    
+    /**
+     * Answer input lines from intraday ticks instead of data.csv:
+     * "2011-01-03T10:15:30.250 | 3" (see Timestamp for the forms)
+     * Ticks are BTC rates: lines naming assets are then bad input.
+     */
+    bool loadTicks(const std::string& filename, bool compact);
+    
+    size_t size() const;
+    
     /**
      * Process input file with transactions
      * Format: date | value
      * Example:
      *   2011-01-03 | 3
      *   2012-01-11 | 1
+     * 
+     * Range queries over the rates in effect between two dates:
+     *   2011-01-03 .. 2011-12-31 | min      (also max, avg)
+     * With loadAssets, other assets by name:
+     *   2011-01-03 | 3 | ETH,LTC
+     * 
+     * "-" reads stdin; stdin, pipes and FIFOs go to processInputStream
      */
     void processInputFile(const std::string& filename);
+    
+    /**
+     * Same output as processInputFile, read from fd as it arrives
+     * through a fixed STREAM_BUFFER_BYTES buffer (constant memory,
+     * results written after every read)
+     */
+    void processInputStream(int fd);
+    
+    /**
+     * --stats: line outcomes, lookups, bytes and per-stage times of
+     * the loads and input processed so far (see RunStats)
+     */
+    void printStats(std::ostream& out, bool json) const;
+    
+    /**
+     * Resolve a whole block of queries against the database
+     * (closest lower date, as processInputFile does per line)
+     * Fills found/rate/result of every query, in place
+     */
+    void resolveQueries(std::vector<Query>& queries) const;
+    
+    /**
+     * Stream form of processInputFile: append the output of the
+     * complete lines in [begin, end) to out (see BitcoinExchange.cpp)
+     */
+    void processLines(const char* begin, const char* end,
+                      std::string& out, bool& fresh) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include "BtcServer.hpp"
+#include "Helpers.hpp"
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void onStopSignal(int)
+{
+    g_stop = 1;
+}
+
+static long nowMillis()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+}
+
+static bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+BtcServer::BtcServer(BitcoinExchange& exchange)
+    : _exchange(exchange), _listenFd(-1)
+{
+}
+
+BtcServer::~BtcServer()
+{
+    while (!_clients.empty())
+        closeClient(_clients.size() - 1);
+    if (_listenFd >= 0)
+    {
+        close(_listenFd);
+        unlink(_path.c_str());
+    }
+}
+
+bool BtcServer::acceptClients()
+{
+    for (;;)
+    {
+        int fd = accept(_listenFd, NULL, NULL);
+        if (fd < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        if (!setNonBlocking(fd))
+        {
+            close(fd);
+            continue;
+        }
+        Client client;
+        client.fd = fd;
+        client.sent = 0;
+        client.scanned = 0;
+        client.headerChecked = false;
+        client.overlong = false;
+        client.fresh = true;
+        client.eof = false;
+        _clients.push_back(client);
+    }
+}
+
+/**
+ * Read what the socket has into client.in (at most MAX_PENDING_INPUT
+ * bytes per round, so one fast writer cannot starve the others)
+ * Returns false on a connection error
+ */
+bool BtcServer::readClient(Client& client)
+{
+    char buf[READ_SIZE];
+
+    for (;;)
+    {
+        ssize_t n = recv(client.fd, buf, sizeof(buf), 0);
+        if (n > 0)
+        {
+            client.in.append(buf, static_cast<size_t>(n));
+            if (client.in.size() >= MAX_PENDING_INPUT)
+                return true;
+            continue;
+        }
+        if (n == 0)
+        {
+            client.eof = true;
+            return true;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+}
+
+/**
+ * Echo the rest of an overlong line up to its '\n' (or the end of the
+ * client's input); returns true once the line is finished
+ */
+bool BtcServer::skipOverlong(Client& client)
+{
+    size_t nl = client.in.find('\n');
+    if (nl == std::string::npos)
+    {
+        client.out += client.in;
+        client.in.clear();
+        client.scanned = 0;
+        if (!client.eof)
+            return false;
+    }
+    else
+    {
+        client.out.append(client.in, 0, nl);
+        client.in.erase(0, nl + 1);
+    }
+    client.out += '\n';
+    client.overlong = false;
+    return true;
+}
+
+/**
+ * Answer every complete line of client.in in one block
+ * (plus the final unterminated line once the client is done sending)
+ * 
+ * Only the bytes received since the last call are searched for a
+ * '\n', so a long line costs linear time. An unterminated line that
+ * reaches MAX_PENDING_INPUT is reported and skipped (skipOverlong).
+ */
+void BtcServer::processClient(Client& client)
+{
+    if (client.overlong && !skipOverlong(client))
+        return;
+
+    const char* data = client.in.data();
+    size_t end = client.in.size();
+    if (!client.eof)
+    {
+        const char* last = Helpers::lastNewline(data + client.scanned,
+                                                client.in.size() - client.scanned);
+        if (!last)
+        {
+            client.scanned = client.in.size();
+            if (client.in.size() >= MAX_PENDING_INPUT)
+            {
+                client.out += "Error: bad input => ";
+                client.out += client.in;
+                client.in.clear();
+                client.scanned = 0;
+                client.overlong = true;
+                client.headerChecked = true;
+            }
+            return;
+        }
+        end = static_cast<size_t>(last - data) + 1;
+    }
+
+    size_t begin = 0;
+    if (!client.headerChecked)
+    {
+        size_t nl = client.in.find('\n');
+        if (nl == std::string::npos && !client.eof)
+            return;
+        size_t line_end = (nl == std::string::npos) ? client.in.size() : nl;
+        if (client.in.compare(0, line_end, "date | value") == 0)
+            begin = (nl == std::string::npos) ? line_end : nl + 1;
+        client.headerChecked = true;
+    }
+
+    if (begin < end)
+        _exchange.processLines(data + begin, data + end, client.out, client.fresh);
+    client.in.erase(0, end);
+    client.scanned = client.in.size();
+}
+
+/**
+ * Send as much pending output as the socket takes
+ * Returns false on a connection error
+ */
+bool BtcServer::writeClient(Client& client)
+{
+    while (client.sent < client.out.size())
+    {
+        ssize_t n = send(client.fd, client.out.data() + client.sent,
+                         client.out.size() - client.sent, MSG_NOSIGNAL);
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        client.sent += static_cast<size_t>(n);
+    }
+    client.out.clear();
+    client.sent = 0;
+    return true;
+}
+
+void BtcServer::closeClient(size_t index)
+{
+    close(_clients[index].fd);
+    _clients[index] = _clients.back();
+    _clients.pop_back();
+}
+
+bool BtcServer::run(const std::string& path)
+{
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.length() >= sizeof(addr.sun_path))
+        return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.length() + 1);
+
+    _listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (_listenFd < 0)
+        return false;
+    unlink(path.c_str());
+    if (bind(_listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0
+        || listen(_listenFd, SOMAXCONN) != 0 || !setNonBlocking(_listenFd))
+    {
+        close(_listenFd);
+        _listenFd = -1;
+        return false;
+    }
+    _path = path;
+
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onStopSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    std::vector<struct pollfd> fds;
+    long next_reload = nowMillis() + RELOAD_INTERVAL_MS;
+    while (!g_stop)
+    {
+        long now = nowMillis();
+        if (now >= next_reload)
+        {
+            _exchange.refreshDatabase();
+            next_reload = now + RELOAD_INTERVAL_MS;
+        }
+
+        // Listening socket first, then one entry per client
+        fds.resize(_clients.size() + 1);
+        fds[0].fd = _listenFd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        for (size_t i = 0; i < _clients.size(); i++)
+        {
+            Client& client = _clients[i];
+            bool backlogged = client.out.size() - client.sent > MAX_PENDING_OUTPUT;
+            fds[i + 1].fd = client.fd;
+            fds[i + 1].events = 0;
+            if (!client.eof && !backlogged)
+                fds[i + 1].events |= POLLIN;
+            if (client.sent < client.out.size())
+                fds[i + 1].events |= POLLOUT;
+            fds[i + 1].revents = 0;
+        }
+
+        int timeout = static_cast<int>(next_reload - now);
+        if (poll(&fds[0], fds.size(), timeout < 0 ? 0 : timeout) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        // Walk backwards: closeClient moves the last client into the hole
+        for (size_t i = _clients.size(); i > 0; i--)
+        {
+            Client& client = _clients[i - 1];
+            short revents = fds[i].revents;
+            bool ok = true;
+
+            if (revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                ok = readClient(client);
+                if (ok)
+                    processClient(client);
+            }
+            if (ok)
+                ok = writeClient(client);
+            if (!ok || (client.eof && client.sent == client.out.size()))
+                closeClient(i - 1);
+        }
+
+        if (fds[0].revents & POLLIN)
+            acceptClients();
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef BTC_SERVER_HPP
+#define BTC_SERVER_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "BitcoinExchange.hpp"
+
+/**
+ * BtcServer: keeps one loaded BitcoinExchange resident and answers
+ * "date | value" lines from many clients over a Unix domain socket
+ *
+ * Protocol: a connection is treated exactly like an input file.
+ * - Lines are '\n' terminated; requests may be pipelined freely
+ * - The first line is skipped if it is exactly "date | value"
+ * - Each line gets the same output line(s) processInputFile prints,
+ *   in order (empty lines get none, like in a file)
+ * - When the client shuts down its write side, a last unterminated
+ *   line is processed, pending output is sent and the server closes
+ * So `socat - UNIX-CONNECT:sock < input.txt` prints what ./btc prints.
+ *
+ * Single-threaded poll() event loop:
+ * - Every readable client has all of its complete lines processed as
+ *   one block (BitcoinExchange::processLines), so the lookups of a
+ *   pipelined burst are resolved in one batch
+ * - A client whose unsent output exceeds MAX_PENDING_OUTPUT is not read
+ *   until it drains, so a slow reader cannot grow server memory
+ * - A line still unterminated after MAX_PENDING_INPUT bytes is bad
+ *   input: it is echoed and skipped up to its '\n' as it arrives, like
+ *   processInputStream does, so a client that never sends '\n' cannot
+ *   grow server memory either
+ * - Every RELOAD_INTERVAL_MS the database CSV is checked for new rows
+ *   (BitcoinExchange::refreshDatabase); requests see the new rates from
+ *   their next block on
+ * - SIGINT/SIGTERM stop the loop; the socket file is removed
+ */
+class BtcServer
+{
+public:
+    static const size_t READ_SIZE = 1 << 16;
+    static const size_t MAX_PENDING_INPUT = 1 << 20;
+    static const size_t MAX_PENDING_OUTPUT = 1 << 20;
+    static const int RELOAD_INTERVAL_MS = 1000;
+
+private:
+    struct Client
+    {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t sent;
+        size_t scanned;         // in[0, scanned) holds no '\n'
+        bool headerChecked;
+        bool overlong;          // skipping the rest of an overlong line
+        bool fresh;
+        bool eof;
+    };
+
+    BitcoinExchange& _exchange;
+    int _listenFd;
+    std::string _path;
+    std::vector<Client> _clients;
+
+    bool acceptClients();
+    bool readClient(Client& client);
+    bool skipOverlong(Client& client);
+    void processClient(Client& client);
+    bool writeClient(Client& client);
+    void closeClient(size_t index);
+
+    BtcServer(const BtcServer& other);
+    BtcServer& operator=(const BtcServer& other);
+
+public:
+    explicit BtcServer(BitcoinExchange& exchange);
+    ~BtcServer();
+
+    /**
+     * Bind `path` and serve until SIGINT/SIGTERM
+     * Returns false if the socket cannot be set up
+     */
+    bool run(const std::string& path);
+};
+
+#endif
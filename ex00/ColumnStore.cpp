@@ -0,0 +1,220 @@
+#include "ColumnStore.hpp"
+#include "DatabaseLoader.hpp"
+#include "Helpers.hpp"
+#include "MappedFile.hpp"
+#include "DateKey.hpp"
+#include "FloatParser.hpp"
+#include <algorithm>
+#include <cstring>
+
+/**
+ * Sort a column by date; the last of each run of equal dates wins
+ */
+static void sortColumn(std::vector<PriceIndex::Entry>& entries)
+{
+    std::stable_sort(entries.begin(), entries.end(), Helpers::entryKeyLess);
+
+    size_t out = 0;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (out > 0 && entries[out - 1].key == entries[i].key)
+            entries[out - 1] = entries[i];
+        else
+            entries[out++] = entries[i];
+    }
+    entries.resize(out);
+}
+
+ColumnStore::ColumnStore()
+{
+}
+
+ColumnStore::~ColumnStore()
+{
+}
+
+/**
+ * Index in _pending of the column called name, added if new
+ * (an index, not a reference: adding may reallocate _pending)
+ */
+size_t ColumnStore::pendingColumn(const std::string& name)
+{
+    for (size_t i = 0; i < _pending.size(); i++)
+    {
+        if (_pending[i].name == name)
+            return i;
+    }
+    _pending.push_back(PendingColumn());
+    _pending.back().name = name;
+    return _pending.size() - 1;
+}
+
+bool ColumnStore::addCsv(const std::string& name, const std::string& filename)
+{
+    std::vector<PriceIndex::Entry> entries;
+    if (name.empty() || !DatabaseLoader::load(filename, 1, entries))
+        return false;
+
+    PendingColumn& column = _pending[pendingColumn(name)];
+    column.entries.insert(column.entries.end(), entries.begin(), entries.end());
+    return true;
+}
+
+/**
+ * Wide CSV: the header names the columns, each row has a date and one
+ * cell per column. Rows with a bad date and cells that are empty or
+ * not a number are skipped, like bad rows of data.csv.
+ */
+bool ColumnStore::addWideCsv(const std::string& filename)
+{
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+
+    const char* p = file.data();
+    const char* end = p + file.size();
+    std::vector<size_t> slots;
+    bool header = true;
+
+    while (p < end)
+    {
+        const char* nl = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        const char* line_end = nl ? nl : end;
+        PriceIndex::Entry entry;
+        size_t cell = 0;
+        bool valid = true;
+
+        for (const char* field = p; valid && field <= line_end; cell++)
+        {
+            const char* comma = static_cast<const char*>(
+                std::memchr(field, ',', static_cast<size_t>(line_end - field)));
+            const char* field_end = comma ? comma : line_end;
+            const char* begin = field;
+            const char* stop = field_end;
+            Helpers::trim(begin, stop);
+            size_t len = static_cast<size_t>(stop - begin);
+
+            if (header && cell > 0)
+            {
+                size_t slot = NOT_FOUND;
+                if (len > 0)
+                    slot = pendingColumn(std::string(begin, len));
+                slots.push_back(slot);
+            }
+            else if (!header && cell == 0)
+                valid = DateKey::parse(begin, len, entry.key);
+            else if (!header && cell <= slots.size() && slots[cell - 1] != NOT_FOUND
+                     && len > 0 && FloatParser::parse(begin, len, entry.rate))
+                _pending[slots[cell - 1]].entries.push_back(entry);
+
+            field = field_end + 1;
+        }
+        header = false;
+        p = line_end + 1;
+    }
+    return true;
+}
+
+/**
+ * Merge the pending columns:
+ * 1. Sort each column, last duplicate wins
+ * 2. _keys = sorted union of every column's dates
+ * 3. Walk each column against _keys, forward-filling the gaps
+ */
+void ColumnStore::build()
+{
+    for (size_t c = 0; c < _pending.size(); c++)
+        sortColumn(_pending[c].entries);
+
+    std::vector<uint32_t> keys;
+    for (size_t c = 0; c < _pending.size(); c++)
+    {
+        for (size_t i = 0; i < _pending[c].entries.size(); i++)
+            keys.push_back(_pending[c].entries[i].key);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    size_t rows = keys.size();
+    std::vector<float> rates(rows * _pending.size());
+    std::vector<std::string> names(_pending.size());
+    std::vector<size_t> first_row(_pending.size());
+
+    for (size_t c = 0; c < _pending.size(); c++)
+    {
+        const std::vector<PriceIndex::Entry>& entries = _pending[c].entries;
+        float* column = rates.empty() ? NULL : &rates[c * rows];
+        size_t next = 0;
+        float current = 0;
+
+        first_row[c] = rows;
+        for (size_t row = 0; row < rows; row++)
+        {
+            if (next < entries.size() && entries[next].key == keys[row])
+            {
+                if (next == 0)
+                    first_row[c] = row;
+                current = entries[next++].rate;
+            }
+            column[row] = current;
+        }
+        names[c] = _pending[c].name;
+    }
+
+    std::vector<uint32_t>(keys.begin(), keys.end()).swap(_keys);
+    _rates.swap(rates);
+    _names.swap(names);
+    _firstRow.swap(first_row);
+    std::vector<PendingColumn>().swap(_pending);
+}
+
+size_t ColumnStore::rows() const
+{
+    return _keys.size();
+}
+
+size_t ColumnStore::columns() const
+{
+    return _names.size();
+}
+
+const std::string& ColumnStore::name(size_t column) const
+{
+    return _names[column];
+}
+
+size_t ColumnStore::findColumn(const char* name, size_t len) const
+{
+    for (size_t c = 0; c < _names.size(); c++)
+    {
+        if (_names[c].compare(0, std::string::npos, name, len) == 0)
+            return c;
+    }
+    return NOT_FOUND;
+}
+
+bool ColumnStore::findRow(uint32_t key, size_t& row) const
+{
+    if (_keys.empty() || key < _keys[0])
+        return false;
+
+    row = Helpers::lowerOrEqual(&_keys[0], _keys.size(), key);
+    return true;
+}
+
+bool ColumnStore::rate(size_t row, size_t column, float& rate) const
+{
+    if (row < _firstRow[column])
+        return false;
+    rate = _rates[column * _keys.size() + row];
+    return true;
+}
+
+/**
+ * Bytes used by the row data (keys + every column)
+ */
+size_t ColumnStore::memoryUsage() const
+{
+    return _keys.capacity() * sizeof(uint32_t) + _rates.capacity() * sizeof(float);
+}
@@ -0,0 +1,97 @@
+#ifndef COLUMN_STORE_HPP
+#define COLUMN_STORE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include "PriceIndex.hpp"
+#include "RefCounted.hpp"
+
+/**
+ * ColumnStore: rates of several assets against one shared date index
+ *
+ * Layout (one row per date any asset has):
+ *   _keys:  [k0, k1, k2, ...]        sorted DateKey day numbers
+ *   _rates: [A0 A1 A2 ... | B0 B1 B2 ... | ...]
+ *           one contiguous column per asset (column c at c * rows)
+ *
+ * Columns are forward-filled: where asset B has no row of its own,
+ * B[i] repeats B's closest lower rate, and _firstRow[c] is the first
+ * row where column c has a rate at all. So one search for the row
+ * gives closest-lower-date answers for every column:
+ *   row = last i with _keys[i] <= key
+ *   rate(c) = row >= _firstRow[c] ? _rates[c * rows + row] : none
+ *
+ * Cost: 4 bytes per row for the keys plus 4 bytes per row per column,
+ * instead of K separate key arrays and K searches.
+ *
+ * Loading: addCsv (a date,rate file, same rules as data.csv) and
+ * addWideCsv (date,NAME1,NAME2,... with empty cells for missing rates)
+ * collect columns; build() merges them. Later duplicates win, as in
+ * loadDatabase. Not thread-safe while loading; read-only afterwards.
+ */
+class ColumnStore : public RefCounted<ColumnStore>
+{
+private:
+    struct PendingColumn
+    {
+        std::string name;
+        std::vector<PriceIndex::Entry> entries;
+    };
+
+    std::vector<uint32_t> _keys;
+    std::vector<float> _rates;
+    std::vector<std::string> _names;
+    std::vector<size_t> _firstRow;
+    std::vector<PendingColumn> _pending;
+
+    size_t pendingColumn(const std::string& name);
+
+    ColumnStore(const ColumnStore& other);
+    ColumnStore& operator=(const ColumnStore& other);
+
+public:
+    static const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    ColumnStore();
+    ~ColumnStore();
+
+    /**
+     * Add a date,rate file as column `name`
+     */
+    bool addCsv(const std::string& name, const std::string& filename);
+
+    /**
+     * Add every column of a "date,NAME1,NAME2,..." file
+     */
+    bool addWideCsv(const std::string& filename);
+
+    /**
+     * Merge the loaded columns into the shared index
+     */
+    void build();
+
+    size_t rows() const;
+    size_t columns() const;
+    const std::string& name(size_t column) const;
+
+    /**
+     * Column number of an asset name (NOT_FOUND if unknown)
+     */
+    size_t findColumn(const char* name, size_t len) const;
+
+    /**
+     * Row in effect on key (last row <= key); false if before all rows
+     */
+    bool findRow(uint32_t key, size_t& row) const;
+
+    /**
+     * Rate of column in row; false if the asset has no rate by then
+     */
+    bool rate(size_t row, size_t column, float& rate) const;
+
+    size_t memoryUsage() const;
+};
+
+#endif
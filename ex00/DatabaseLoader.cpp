@@ -0,0 +1,174 @@
+#include "DatabaseLoader.hpp"
+#include "Helpers.hpp"
+#include "MappedFile.hpp"
+#include "DateKey.hpp"
+#include "FloatParser.hpp"
+#include <cstring>
+#include <pthread.h>
+
+struct RangeJob
+{
+    const char* begin;
+    const char* end;
+    std::vector<PriceIndex::Entry> entries;
+};
+
+/**
+ * Parse one line (without its '\n')
+ * Returns false for rows loadDatabase skips
+ */
+bool DatabaseLoader::parseLine(const char* line, size_t len, PriceIndex::Entry& entry)
+{
+    if (len == 0)
+        return false;
+
+    const char* comma = static_cast<const char*>(std::memchr(line, ',', len));
+    if (!comma)
+        return false;
+
+    const char* date_begin = line;
+    const char* date_end = comma;
+    const char* rate_begin = comma + 1;
+    const char* rate_end = line + len;
+    Helpers::trim(date_begin, date_end);
+    Helpers::trim(rate_begin, rate_end);
+
+    if (!DateKey::parse(date_begin, static_cast<size_t>(date_end - date_begin), entry.key))
+        return false;
+
+    return FloatParser::parse(rate_begin, static_cast<size_t>(rate_end - rate_begin), entry.rate);
+}
+
+void DatabaseLoader::parseRange(const char* begin, const char* end,
+                                std::vector<PriceIndex::Entry>& entries)
+{
+    PriceIndex::Entry entry;
+
+    while (begin < end)
+    {
+        const char* nl = static_cast<const char*>(
+            std::memchr(begin, '\n', static_cast<size_t>(end - begin)));
+        const char* line_end = nl ? nl : end;
+
+        if (parseLine(begin, static_cast<size_t>(line_end - begin), entry))
+            entries.push_back(entry);
+
+        begin = line_end + 1;
+    }
+}
+
+void* DatabaseLoader::parseRangeThread(void* arg)
+{
+    RangeJob* job = static_cast<RangeJob*>(arg);
+    parseRange(job->begin, job->end, job->entries);
+    return NULL;
+}
+
+bool DatabaseLoader::load(const std::string& filename, size_t threads,
+                          std::vector<PriceIndex::Entry>& entries)
+{
+    size_t next;
+    bool pending;
+    return load(filename, 0, threads, entries, next, pending);
+}
+
+/**
+ * Load algorithm:
+ * 1. Map the file
+ * 2. Skip the header line (offset 0) or everything before offset
+ * 3. Cut the body into `threads` ranges, each ending just after a '\n'
+ * 4. Parse ranges (range 0 on the calling thread, the rest on pthreads)
+ * 5. Concatenate results in range order
+ */
+bool DatabaseLoader::load(const std::string& filename, size_t offset, size_t threads,
+                          std::vector<PriceIndex::Entry>& entries, size_t& next,
+                          bool& pending)
+{
+    MappedFile file;
+    if (!file.open(filename) || offset > file.size())
+        return false;
+
+    entries.clear();
+    next = offset;
+    pending = false;
+    if (file.size() == offset)
+        return true;
+
+    const char* data = file.data();
+    const char* end = data + file.size();
+    const char* last_nl = Helpers::lastNewline(data + offset, file.size() - offset);
+    if (last_nl)
+        next = static_cast<size_t>(last_nl + 1 - data);
+
+    // Skip header line
+    const char* body = data + offset;
+    if (offset == 0)
+    {
+        body = static_cast<const char*>(std::memchr(data, '\n', file.size()));
+        if (!body)
+            return true;
+        body++;
+    }
+
+    PriceIndex::Entry last;
+    pending = (next < file.size() && data + next >= body
+               && parseLine(data + next, file.size() - next, last));
+
+    size_t body_size = static_cast<size_t>(end - body);
+    if (threads < 1)
+        threads = 1;
+    if (threads > body_size / MIN_BYTES_PER_THREAD)
+        threads = body_size / MIN_BYTES_PER_THREAD;
+
+    if (threads <= 1)
+    {
+        // ~20 bytes per row is typical; avoids most regrowth
+        entries.reserve(body_size / 20);
+        parseRange(body, end, entries);
+        return true;
+    }
+
+    std::vector<RangeJob> jobs(threads);
+    const char* cursor = body;
+    for (size_t i = 0; i < threads; i++)
+    {
+        const char* cut = (i + 1 == threads) ? end : body + body_size * (i + 1) / threads;
+        if (cut < cursor)
+            cut = cursor;
+        if (cut < end)
+        {
+            const char* nl = static_cast<const char*>(
+                std::memchr(cut, '\n', static_cast<size_t>(end - cut)));
+            cut = nl ? nl + 1 : end;
+        }
+        jobs[i].begin = cursor;
+        jobs[i].end = cut;
+        jobs[i].entries.reserve(static_cast<size_t>(cut - cursor) / 20);
+        cursor = cut;
+    }
+
+    std::vector<pthread_t> tids(threads);
+    std::vector<bool> started(threads, false);
+    for (size_t i = 1; i < threads; i++)
+        started[i] = (pthread_create(&tids[i], NULL, parseRangeThread, &jobs[i]) == 0);
+
+    parseRange(jobs[0].begin, jobs[0].end, jobs[0].entries);
+
+    size_t total = 0;
+    for (size_t i = 0; i < threads; i++)
+    {
+        if (i > 0)
+        {
+            if (started[i])
+                pthread_join(tids[i], NULL);
+            else
+                parseRange(jobs[i].begin, jobs[i].end, jobs[i].entries);
+        }
+        total += jobs[i].entries.size();
+    }
+
+    entries.reserve(total);
+    for (size_t i = 0; i < threads; i++)
+        entries.insert(entries.end(), jobs[i].entries.begin(), jobs[i].entries.end());
+    return true;
+}
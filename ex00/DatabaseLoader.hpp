@@ -0,0 +1,66 @@
+#ifndef DATABASE_LOADER_HPP
+#define DATABASE_LOADER_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "PriceIndex.hpp"
+
+/**
+ * DatabaseLoader: in-place parser for the date,exchange_rate CSV
+ *
+ * The file is mapped (MappedFile) and scanned with memchr for '\n' and
+ * ','. Dates go through DateKey and rates through FloatParser, so no
+ * per-row strings are built.
+ *
+ * Row rules are the ones loadDatabase always had:
+ * - The first line is a header and is skipped
+ * - Empty lines and lines without a comma are skipped
+ * - Both fields are trimmed of whitespace
+ * - Rows with an invalid date or rate are skipped
+ *
+ * Big files can be split into line-aligned byte ranges parsed on
+ * several threads; the per-range results are concatenated in file
+ * order, so "last duplicate wins" is preserved.
+ */
+class DatabaseLoader
+{
+private:
+    DatabaseLoader();
+
+    static void* parseRangeThread(void* arg);
+
+public:
+    // Below this size a single thread is always used
+    static const size_t MIN_BYTES_PER_THREAD = 4 << 20;
+
+    /**
+     * Load every valid row of filename, in file order
+     * Returns false only if the file cannot be opened
+     */
+    static bool load(const std::string& filename, size_t threads,
+                     std::vector<PriceIndex::Entry>& entries);
+
+    /**
+     * Incremental form: load the rows from byte `offset` on (0 = whole
+     * file, header included; otherwise a line start after the header)
+     * `next` receives the offset just past the last '\n', where the
+     * next call should resume. A final unterminated line is parsed now
+     * and again next time; `pending` tells whether it produced the last
+     * entry (which the caller must be able to take back).
+     * Returns false if the file cannot be opened or is shorter than offset
+     */
+    static bool load(const std::string& filename, size_t offset, size_t threads,
+                     std::vector<PriceIndex::Entry>& entries, size_t& next,
+                     bool& pending);
+
+    /**
+     * Parse the complete lines in [begin, end)
+     */
+    static void parseRange(const char* begin, const char* end,
+                           std::vector<PriceIndex::Entry>& entries);
+
+    static bool parseLine(const char* line, size_t len, PriceIndex::Entry& entry);
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "DateKey.hpp"
+#include <cstring>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+# define DATE_KEY_SWAR 1
+#else
+# define DATE_KEY_SWAR 0
+#endif
+
+static const uint64_t ONES = 0x0101010101010101ULL;
+static const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+// Bytes 4 and 7 of "YYYY-MM-" hold the separators
+static const uint64_t SEPARATOR_MASK = 0xff0000ff00000000ULL;
+static const uint64_t SEPARATORS = 0x2d00002d00000000ULL;
+
+/**
+ * SWAR digit test: high bit of each byte set where the byte is not '0'-'9'
+ *
+ * For each byte v (all lanes at once, no carries between lanes):
+ * - (v & 0x7f) + 0x46 reaches 0x80 when (v & 0x7f) >= ':'
+ * - (v | 0x80) - 0x30 drops below 0x80 when (v & 0x7f) < '0'
+ * - v itself has the high bit set for bytes >= 0x80
+ */
+static uint64_t nonDigitMask(uint64_t word)
+{
+    uint64_t too_high = (word & ~HIGH_BITS) + 0x46 * ONES;
+    uint64_t not_low = (word | HIGH_BITS) - 0x30 * ONES;
+    return (too_high | ~not_low | word) & HIGH_BITS;
+}
+
+/**
+ * Parse YYYY-MM-DD into year, month, day and the day number
+ * Same rules as the original isValidDate:
+ * - Exactly 10 characters, '-' at positions 4 and 7, digits elsewhere
+ * - Year 1900-2999, month 01-12, day 01-31 (for every month: "02-31"
+ *   was always accepted, and key order keeps it before "03-01")
+ *
+ * Fast path (little-endian): "YYYY-MM-" is loaded as one 64-bit word
+ * and "DD" as a 16-bit one. The separators are checked with one masked
+ * compare, then replaced by the two day digits so a single nonDigitMask
+ * validates all 8 digits. Range checks are combined with & so the only
+ * branches are the two early returns.
+ */
+bool DateKey::parse(const char* str, size_t len, Fields& fields)
+{
+    if (len != 10)
+        return false;
+
+#if DATE_KEY_SWAR
+    uint64_t head;
+    uint16_t tail;
+    std::memcpy(&head, str, sizeof(head));
+    std::memcpy(&tail, str + 8, sizeof(tail));
+
+    // Move the day digits into the separator lanes:
+    // lanes = Y0 Y1 Y2 Y3 D0 M0 M1 D1
+    uint64_t digits = (head & ~SEPARATOR_MASK)
+                    | (static_cast<uint64_t>(tail & 0xff) << 32)
+                    | (static_cast<uint64_t>(tail >> 8) << 56);
+    bool ok = ((head & SEPARATOR_MASK) == SEPARATORS) & (nonDigitMask(digits) == 0);
+    if (!ok)
+        return false;
+
+    // Digit values, then pairs: lane 0 = Y0Y1, lane 2 = Y2Y3, lane 5 = M0M1
+    uint64_t d = digits - 0x30 * ONES;
+    uint64_t pairs = d * 10 + (d >> 8);
+    int year = static_cast<int>(pairs & 0xff) * 100 + static_cast<int>((pairs >> 16) & 0xff);
+    int month = static_cast<int>((pairs >> 40) & 0xff);
+    int day = static_cast<int>((d >> 32) & 0xff) * 10 + static_cast<int>(d >> 56);
+#else
+    if (str[4] != '-' || str[7] != '-')
+        return false;
+
+    for (int i = 0; i < 10; i++)
+    {
+        if (i == 4 || i == 7)
+            continue;
+        if (str[i] < '0' || str[i] > '9')
+            return false;
+    }
+
+    int year = (str[0] - '0') * 1000 + (str[1] - '0') * 100
+             + (str[2] - '0') * 10 + (str[3] - '0');
+    int month = (str[5] - '0') * 10 + (str[6] - '0');
+    int day = (str[8] - '0') * 10 + (str[9] - '0');
+#endif
+
+    bool in_range = (static_cast<unsigned int>(year - MIN_YEAR)
+                     <= static_cast<unsigned int>(MAX_YEAR - MIN_YEAR))
+                  & (static_cast<unsigned int>(month - 1) < MONTHS_PER_YEAR)
+                  & (static_cast<unsigned int>(day - 1) < DAYS_PER_MONTH);
+    if (!in_range)
+        return false;
+
+    fields.year = year;
+    fields.month = month;
+    fields.day = day;
+    fields.key = fromYMD(year, month, day);
+    return true;
+}
+
+bool DateKey::parse(const char* str, size_t len, uint32_t& key)
+{
+    Fields fields;
+    if (!parse(str, len, fields))
+        return false;
+    key = fields.key;
+    return true;
+}
+
+bool DateKey::parse(const std::string& date, uint32_t& key)
+{
+    return parse(date.c_str(), date.length(), key);
+}
+
+uint32_t DateKey::fromYMD(int year, int month, int day)
+{
+    return (static_cast<uint32_t>(year - MIN_YEAR) * MONTHS_PER_YEAR
+            + static_cast<uint32_t>(month - 1)) * DAYS_PER_MONTH
+           + static_cast<uint32_t>(day - 1);
+}
@@ -0,0 +1,54 @@
+#ifndef DATE_KEY_HPP
+#define DATE_KEY_HPP
+
+#include <string>
+#include <stdint.h>
+
+/**
+ * DateKey converts YYYY-MM-DD strings into 32-bit day numbers
+ *
+ * The numbering uses a fixed 31-day month:
+ *   key = ((year - 1900) * 12 + (month - 1)) * 31 + (day - 1)
+ *
+ * Why not a real calendar day count?
+ * - isValidDate accepts any day 01-31 for every month ("2011-02-31")
+ * - Such dates must still sort between 2011-02-28 and 2011-03-01,
+ *   exactly like the string keys of the old std::map did
+ * - Key order == string order for every accepted date, so
+ *   closest-lower-date semantics are unchanged
+ *
+ * The whole valid range (1900-01-01 .. 2999-12-31) fits in 409200 keys.
+ */
+class DateKey
+{
+private:
+    DateKey();
+
+public:
+    static const uint32_t DAYS_PER_MONTH = 31;
+    static const uint32_t MONTHS_PER_YEAR = 12;
+    static const int MIN_YEAR = 1900;
+    static const int MAX_YEAR = 2999;
+    // Number of distinct keys: every key is < KEY_SPACE
+    static const uint32_t KEY_SPACE = (MAX_YEAR - MIN_YEAR + 1) * 12 * 31;
+
+    struct Fields
+    {
+        int year;
+        int month;
+        int day;
+        uint32_t key;
+    };
+
+    /**
+     * Parse and validate a 10-character date.
+     * Accepts exactly the strings BitcoinExchange::isValidDate accepts.
+     */
+    static bool parse(const char* str, size_t len, Fields& fields);
+    static bool parse(const char* str, size_t len, uint32_t& key);
+    static bool parse(const std::string& date, uint32_t& key);
+
+    static uint32_t fromYMD(int year, int month, int day);
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "FloatFormatter.hpp"
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <stdint.h>
+
+void FloatFormatter::appendFixed2(std::string& out, float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    bool negative = (bits >> 31) != 0;
+    int biased = static_cast<int>((bits >> 23) & 0xff);
+    uint32_t fraction = bits & 0x7fffff;
+
+    // NaN / infinity, or too big for the integer path
+    if (biased == 0xff || biased >= 127 + 32)
+    {
+        appendSlow(out, value);
+        return;
+    }
+
+    // value = mantissa * 2^exponent
+    uint64_t mantissa = biased ? (fraction | 0x800000) : fraction;
+    int exponent = (biased ? biased : 1) - 127 - 23;
+
+    // hundredths = round_half_even(value * 100)
+    uint64_t scaled = mantissa * 100;
+    uint64_t hundredths;
+    if (exponent >= 0)
+        hundredths = scaled << exponent;
+    else if (exponent <= -64)
+        hundredths = 0;
+    else
+    {
+        int shift = -exponent;
+        hundredths = scaled >> shift;
+        uint64_t rest = scaled & ((static_cast<uint64_t>(1) << shift) - 1);
+        uint64_t half = static_cast<uint64_t>(1) << (shift - 1);
+        if (rest > half || (rest == half && (hundredths & 1)))
+            hundredths++;
+    }
+
+    // Render "[-]integer.ff"
+    char buf[32];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    uint64_t cents = hundredths % 100;
+    uint64_t whole = hundredths / 100;
+
+    *--p = static_cast<char>('0' + cents % 10);
+    *--p = static_cast<char>('0' + cents / 10);
+    *--p = '.';
+    do
+    {
+        *--p = static_cast<char>('0' + whole % 10);
+        whole /= 10;
+    } while (whole);
+    if (negative)
+        *--p = '-';
+
+    out.append(p, static_cast<size_t>(end - p));
+}
+
+void FloatFormatter::appendSlow(std::string& out, float value)
+{
+    std::ostringstream fmt;
+    fmt << std::fixed << std::setprecision(2) << value;
+    out += fmt.str();
+}
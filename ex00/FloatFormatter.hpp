@@ -0,0 +1,33 @@
+#ifndef FLOAT_FORMATTER_HPP
+#define FLOAT_FORMATTER_HPP
+
+#include <string>
+
+/**
+ * FloatFormatter: fast "%.2f" for floats, appended to a std::string
+ *
+ * Produces exactly the text of
+ *   std::ostream << std::fixed << std::setprecision(2) << value
+ * which is what processInputFile always printed.
+ *
+ * How it stays exact:
+ * - A float is M * 2^E with M < 2^24, so value * 100 = (100 * M) * 2^E
+ *   is computed in 64-bit integers without any rounding
+ * - The shifted-out bits decide the rounding: above half rounds up,
+ *   exactly half rounds to even (like glibc's printf)
+ * - The sign is printed whenever the sign bit is set ("-0.00")
+ *
+ * NaN, infinities and values >= 2^32 go through an ostringstream.
+ */
+class FloatFormatter
+{
+private:
+    FloatFormatter();
+
+    static void appendSlow(std::string& out, float value);
+
+public:
+    static void appendFixed2(std::string& out, float value);
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "FloatParser.hpp"
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+static const float POW10[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+static const unsigned int MAX_EXACT_MANTISSA = 1u << 24;
+static const size_t MAX_FRACTION_DIGITS = 10;
+
+bool FloatParser::parse(const char* str, size_t len, float& value)
+{
+    size_t i = 0;
+    bool negative = false;
+
+    if (i < len && (str[i] == '-' || str[i] == '+'))
+    {
+        negative = (str[i] == '-');
+        i++;
+    }
+
+    unsigned int mantissa = 0;
+    size_t digits = 0;
+    size_t fraction = 0;
+    bool seen_dot = false;
+
+    for (; i < len; i++)
+    {
+        char c = str[i];
+        if (c >= '0' && c <= '9')
+        {
+            mantissa = mantissa * 10 + static_cast<unsigned int>(c - '0');
+            if (mantissa > MAX_EXACT_MANTISSA)
+                return parseSlow(str, len, value);
+            digits++;
+            if (seen_dot)
+                fraction++;
+        }
+        else if (c == '.' && !seen_dot)
+            seen_dot = true;
+        else
+            return parseSlow(str, len, value);
+    }
+
+    if (digits == 0 || fraction > MAX_FRACTION_DIGITS)
+        return parseSlow(str, len, value);
+
+    float result = static_cast<float>(mantissa);
+    if (fraction)
+        result /= POW10[fraction];
+    value = negative ? -result : result;
+    return true;
+}
+
+/**
+ * strtof fallback on a NUL-terminated copy of the field
+ * Mirrors stringToFloat: an embedded NUL ends the number, like c_str()
+ */
+bool FloatParser::parseSlow(const char* str, size_t len, float& value)
+{
+    char stack_buf[64];
+    std::string heap_buf;
+    const char* cstr;
+
+    if (len < sizeof(stack_buf))
+    {
+        std::memcpy(stack_buf, str, len);
+        stack_buf[len] = '\0';
+        cstr = stack_buf;
+    }
+    else
+    {
+        heap_buf.assign(str, len);
+        cstr = heap_buf.c_str();
+    }
+
+    char* endptr;
+    errno = 0;
+    float result = std::strtof(cstr, &endptr);
+    if (errno == ERANGE || *endptr != '\0')
+        return false;
+
+    value = result;
+    return true;
+}
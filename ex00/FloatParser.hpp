@@ -0,0 +1,34 @@
+#ifndef FLOAT_PARSER_HPP
+#define FLOAT_PARSER_HPP
+
+#include <cstddef>
+
+/**
+ * FloatParser: strtof on a (pointer, length) field, without copying it
+ *
+ * Fast path: [+-]digits[.digits] with at most 24 bits of mantissa and
+ * at most 10 fractional digits. Both the mantissa and the power of ten
+ * are then exact floats, so one IEEE division gives the correctly
+ * rounded result -- bit-identical to strtof.
+ *
+ * Anything else (exponents, inf/nan, hex, long mantissas) is copied to
+ * a stack buffer (a string only past 63 bytes) and handed to strtof,
+ * so the accepted language is exactly what
+ * BitcoinExchange::stringToFloat accepts.
+ */
+class FloatParser
+{
+private:
+    FloatParser();
+
+    static bool parseSlow(const char* str, size_t len, float& value);
+
+public:
+    /**
+     * Returns false where stringToFloat would throw
+     * (ERANGE or trailing characters)
+     */
+    static bool parse(const char* str, size_t len, float& value);
+};
+
+#endif
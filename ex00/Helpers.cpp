@@ -0,0 +1,38 @@
+#include "Helpers.hpp"
+#include <cctype>
+
+void Helpers::trim(const char*& begin, const char*& end)
+{
+    while (begin < end && std::isspace(static_cast<unsigned char>(end[-1])))
+        end--;
+    while (begin < end && std::isspace(static_cast<unsigned char>(*begin)))
+        begin++;
+}
+
+const char* Helpers::lastNewline(const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        if (data[--len] == '\n')
+            return data + len;
+    }
+    return NULL;
+}
+
+bool Helpers::entryKeyLess(const PriceIndex::Entry& a, const PriceIndex::Entry& b)
+{
+    return a.key < b.key;
+}
+
+size_t Helpers::lowerOrEqual(const uint32_t* keys, size_t n, uint32_t key)
+{
+    const uint32_t* base = keys;
+
+    while (n > 1)
+    {
+        size_t half = n / 2;
+        base = (base[half] <= key) ? base + half : base;
+        n -= half;
+    }
+    return static_cast<size_t>(base - keys);
+}
@@ -0,0 +1,64 @@
+#ifndef HELPERS_HPP
+#define HELPERS_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include "PriceIndex.hpp"
+
+/**
+ * Helpers: small pieces shared by the parsers and the sorted indexes
+ * (BitcoinExchange, DatabaseLoader, PriceIndex, ColumnStore, TickIndex)
+ */
+class Helpers
+{
+private:
+    Helpers();
+
+public:
+    /**
+     * Trim whitespace (std::isspace) from both ends of [begin, end)
+     */
+    static void trim(const char*& begin, const char*& end);
+
+    /**
+     * Last '\n' of [data, data + len), or NULL (portable memrchr)
+     */
+    static const char* lastNewline(const char* data, size_t len);
+
+    /**
+     * Order for std::stable_sort of entries by date
+     */
+    static bool entryKeyLess(const PriceIndex::Entry& a, const PriceIndex::Entry& b);
+
+    /**
+     * Branchless binary search for the last of keys[0 .. n) that is <= key
+     * Precondition: n > 0 and keys[0] <= key
+     *
+     * Each step halves the window and moves base with a conditional
+     * select instead of a branch.
+     */
+    static size_t lowerOrEqual(const uint32_t* keys, size_t n, uint32_t key);
+
+    /**
+     * Same search over an array of structs, on the member `field`
+     * (e.g. lowerOrEqual(blocks, n, &Block::first, time))
+     */
+    template <typename Row, typename Key>
+    static size_t lowerOrEqual(const Row* rows, size_t n, Key Row::*field, Key key);
+};
+
+template <typename Row, typename Key>
+size_t Helpers::lowerOrEqual(const Row* rows, size_t n, Key Row::*field, Key key)
+{
+    const Row* base = rows;
+
+    while (n > 1)
+    {
+        size_t half = n / 2;
+        base = (base[half].*field <= key) ? base + half : base;
+        n -= half;
+    }
+    return static_cast<size_t>(base - rows);
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "InterleavedSearch.hpp"
+#include <algorithm>
+
+/**
+ * Per group:
+ * 1. All searches start at the whole array (the first probes share a
+ *    few cache lines and are warm)
+ * 2. Lockstep halving; after each query's step its next probe,
+ *    base + len / 2, is prefetched
+ * 3. Prefetch the rate of every result row, then read them
+ */
+void InterleavedSearch::findRates(const uint32_t* sorted, const float* values, size_t n,
+                                  const uint32_t* keys, size_t count,
+                                  float* rates, unsigned char* found)
+{
+    if (n == 0)
+    {
+        std::fill(found, found + count, 0);
+        return;
+    }
+
+    const uint32_t* base[GROUP];
+
+    for (size_t g = 0; g < count; g += GROUP)
+    {
+        size_t m = (count - g < GROUP) ? count - g : GROUP;
+        const uint32_t* key = keys + g;
+        size_t len = n;
+
+        for (size_t j = 0; j < m; j++)
+            base[j] = sorted;
+
+        while (len > 1)
+        {
+            size_t half = len / 2;
+            len -= half;
+            for (size_t j = 0; j < m; j++)
+            {
+                base[j] = (base[j][half] <= key[j]) ? base[j] + half : base[j];
+                __builtin_prefetch(base[j] + len / 2);
+            }
+        }
+
+        for (size_t j = 0; j < m; j++)
+            __builtin_prefetch(values + (base[j] - sorted));
+        for (size_t j = 0; j < m; j++)
+        {
+            found[g + j] = (*base[j] <= key[j]);
+            if (found[g + j])
+                rates[g + j] = values[base[j] - sorted];
+        }
+    }
+}
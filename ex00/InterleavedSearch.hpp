@@ -0,0 +1,40 @@
+#ifndef INTERLEAVED_SEARCH_HPP
+#define INTERLEAVED_SEARCH_HPP
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * InterleavedSearch: many closest-lower searches over one sorted array,
+ * run side by side to overlap their cache misses
+ *
+ * Once the array is bigger than the last-level cache, each step of a
+ * binary search waits ~100 ns for a load that depends on the previous
+ * one. The searches of different queries do not depend on each other,
+ * so they are advanced in groups of GROUP, one step at a time:
+ *
+ *   step s:  for each query j of the group
+ *              base[j] = (base[j][half] <= key[j]) ? base[j] + half : base[j]
+ *              prefetch base[j][next half]
+ *
+ * By the time the loop comes back to query j, its next probe has been
+ * in flight for GROUP - 1 other steps. The branchless search makes
+ * every query take the same number of steps (log2(n), depending on n
+ * only), so the group stays in lockstep and the queries need no
+ * sorting.
+ */
+class InterleavedSearch
+{
+public:
+    static const size_t GROUP = 32;
+
+    /**
+     * For each i: found[i] = some sorted[row] <= keys[i], and then
+     * rates[i] = values[row] for the last such row
+     */
+    static void findRates(const uint32_t* sorted, const float* values, size_t n,
+                          const uint32_t* keys, size_t count,
+                          float* rates, unsigned char* found);
+};
+
+#endif
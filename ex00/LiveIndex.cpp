@@ -0,0 +1,112 @@
+#include "LiveIndex.hpp"
+#include <sched.h>
+
+LiveIndex::Version::Version()
+    : sourceOffset(0), sourceDev(0), sourceIno(0), sourceSize(0),
+      hasPendingRow(false), pendingKey(0), pendingHadRate(false), pendingOldRate(0),
+      refs(0)
+{
+    sourceMtime.tv_sec = 0;
+    sourceMtime.tv_nsec = 0;
+}
+
+LiveIndex::Reader::Reader(const LiveIndex& live) : _version(live.acquire())
+{
+}
+
+LiveIndex::Reader::~Reader()
+{
+    LiveIndex::release(_version);
+}
+
+const LiveIndex::Version& LiveIndex::Reader::operator*() const
+{
+    return *_version;
+}
+
+const LiveIndex::Version* LiveIndex::Reader::operator->() const
+{
+    return _version;
+}
+
+/**
+ * Start with an empty version, so acquire() never returns NULL
+ */
+LiveIndex::LiveIndex() : _current(new Version()), _pinning(0)
+{
+    _current->refs = 1;
+    pthread_mutex_init(&_writers, NULL);
+}
+
+LiveIndex::LiveIndex(const LiveIndex& other)
+    : _current(const_cast<Version*>(other.acquire())), _pinning(0)
+{
+    pthread_mutex_init(&_writers, NULL);
+}
+
+LiveIndex& LiveIndex::operator=(const LiveIndex& other)
+{
+    if (this != &other)
+    {
+        lockWriters();
+        share(other);
+        unlockWriters();
+    }
+    return *this;
+}
+
+LiveIndex::~LiveIndex()
+{
+    release(_current);
+    pthread_mutex_destroy(&_writers);
+}
+
+const LiveIndex::Version* LiveIndex::acquire() const
+{
+    __sync_fetch_and_add(&_pinning, 1);
+    Version* version = _current;
+    __sync_fetch_and_add(&version->refs, 1);
+    __sync_fetch_and_sub(&_pinning, 1);
+    return version;
+}
+
+void LiveIndex::release(const Version* version)
+{
+    if (__sync_sub_and_fetch(&version->refs, 1) == 0)
+        delete version;
+}
+
+void LiveIndex::publish(Version* next)
+{
+    next->refs = 1;
+    install(next);
+}
+
+void LiveIndex::share(const LiveIndex& other)
+{
+    install(const_cast<Version*>(other.acquire()));
+}
+
+/**
+ * Make next (already holding the reference it is published with)
+ * current, then wait out the readers that may have loaded the old
+ * pointer but not yet referenced it (a few instructions each)
+ */
+void LiveIndex::install(Version* next)
+{
+    Version* old = __sync_lock_test_and_set(&_current, next);
+    __sync_synchronize();
+    while (_pinning != 0)
+        sched_yield();
+    release(old);
+}
+
+void LiveIndex::lockWriters()
+{
+    pthread_mutex_lock(&_writers);
+}
+
+void LiveIndex::unlockWriters()
+{
+    pthread_mutex_unlock(&_writers);
+}
@@ -0,0 +1,116 @@
+#ifndef LIVE_INDEX_HPP
+#define LIVE_INDEX_HPP
+
+#include <cstddef>
+#include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
+#include "PriceIndex.hpp"
+
+/**
+ * LiveIndex: the current version of the price database, replaceable
+ * while other threads are reading it (RCU-style)
+ *
+ * A Version is immutable once published. Updates build a new Version
+ * next to the old one and swap the pointer:
+ *
+ *   reader                        writer (lockWriters held)
+ *   v = acquire()                 next = new Version(...)
+ *   ... lookups in v->index ...   publish(next)  -> old version retired
+ *   release(v)                    (freed by its last reader)
+ *
+ * Readers never block: acquire() is three atomic operations. A reader
+ * that acquired the old version keeps reading it until release(), so
+ * in-flight lookups see one consistent index.
+ *
+ * Reclamation: acquire() loads the pointer and takes a reference while
+ * _pinning is raised. publish() swaps the pointer, then waits until
+ * _pinning drops to zero before dropping the published reference, so
+ * no reader can still be about to reference the retired version.
+ *
+ * Versions are shared, never copied: copying a LiveIndex (or share())
+ * publishes the same version in both (one more reference, no row data
+ * copied). Each LiveIndex publishes its own later versions.
+ */
+class LiveIndex
+{
+public:
+    struct Version
+    {
+        PriceIndex index;
+        // Where the CSV this version was loaded from was read up to
+        // (the byte after its last '\n') and what the file looked like
+        size_t sourceOffset;
+        dev_t sourceDev;
+        ino_t sourceIno;
+        off_t sourceSize;
+        struct timespec sourceMtime;
+        // Row parsed from an unterminated last line, and what its date
+        // held before it: refreshDatabase re-reads that line, so it
+        // must first take the row back out
+        bool hasPendingRow;
+        uint32_t pendingKey;
+        bool pendingHadRate;
+        float pendingOldRate;
+        // Readers + 1 while published
+        mutable long refs;
+
+        Version();
+    };
+
+    /**
+     * RAII reader: acquires the current version, releases it on scope exit
+     */
+    class Reader
+    {
+    private:
+        const Version* _version;
+
+        Reader(const Reader& other);
+        Reader& operator=(const Reader& other);
+
+    public:
+        explicit Reader(const LiveIndex& live);
+        ~Reader();
+
+        const Version& operator*() const;
+        const Version* operator->() const;
+    };
+
+private:
+    Version* volatile _current;
+    mutable volatile long _pinning;
+    pthread_mutex_t _writers;
+
+    void install(Version* next);
+
+public:
+    LiveIndex();
+    LiveIndex(const LiveIndex& other);
+    LiveIndex& operator=(const LiveIndex& other);
+    ~LiveIndex();
+
+    const Version* acquire() const;
+    static void release(const Version* version);
+
+    /**
+     * Make `next` (allocated with new, refs 0) the current version
+     * Takes ownership; the previous version is freed by its last reader
+     */
+    void publish(Version* next);
+
+    /**
+     * Publish the current version of `other` here as well: O(1), the
+     * rows stay in one place until either side publishes a new version
+     */
+    void share(const LiveIndex& other);
+
+    /**
+     * Serialize read-modify-publish sequences between writers
+     * (readers never take this lock)
+     */
+    void lockWriters();
+    void unlockWriters();
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "MappedFile.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile() : _data(NULL), _size(0), _mapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+/**
+ * Map the file read-only
+ * An empty regular file is a valid, empty view (mmap rejects length 0)
+ */
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    bool ok = true;
+    if (S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void* addr = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            _data = static_cast<const char*>(addr);
+            _size = static_cast<size_t>(st.st_size);
+            _mapped = true;
+        }
+        else
+            ok = readFallback(fd);
+    }
+    else if (!S_ISREG(st.st_mode))
+        ok = readFallback(fd);
+
+    ::close(fd);
+    return ok;
+}
+
+bool MappedFile::readFallback(int fd)
+{
+    const size_t chunk = 1 << 16;
+    size_t used = 0;
+
+    for (;;)
+    {
+        _buffer.resize(used + chunk);
+        ssize_t n = ::read(fd, &_buffer[used], chunk);
+        if (n < 0)
+        {
+            _buffer.clear();
+            return false;
+        }
+        if (n == 0)
+            break;
+        used += static_cast<size_t>(n);
+    }
+    _buffer.resize(used);
+    _data = used ? &_buffer[0] : NULL;
+    _size = used;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_mapped)
+        munmap(const_cast<char*>(_data), _size);
+    _buffer.clear();
+    _data = NULL;
+    _size = 0;
+    _mapped = false;
+}
+
+const char* MappedFile::data() const
+{
+    return _data;
+}
+
+size_t MappedFile::size() const
+{
+    return _size;
+}
@@ -0,0 +1,41 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * MappedFile: read-only view of a whole file
+ *
+ * Regular files are mmap'ed, so the bytes are parsed in place straight
+ * from the page cache with no copy. Files that cannot be mapped
+ * (pipes, character devices) are read into an owned buffer instead.
+ *
+ * Not copyable: the object owns the mapping.
+ */
+class MappedFile
+{
+private:
+    const char* _data;
+    size_t _size;
+    bool _mapped;
+    std::vector<char> _buffer;
+
+    bool readFallback(int fd);
+
+    MappedFile(const MappedFile& other);
+    MappedFile& operator=(const MappedFile& other);
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string& filename);
+    void close();
+
+    const char* data() const;
+    size_t size() const;
+};
+
+#endif
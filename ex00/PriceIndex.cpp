@@ -0,0 +1,524 @@
+#include "PriceIndex.hpp"
+#include "Helpers.hpp"
+#include "InterleavedSearch.hpp"
+#include "DateKey.hpp"
+#include <algorithm>
+
+PriceIndex::PriceIndex() : _denseWanted(false), _denseBase(0), _rangesReady(0)
+{
+    pthread_mutex_init(&_rangesLock, NULL);
+}
+
+PriceIndex::PriceIndex(const PriceIndex& other)
+    : _keys(other._keys), _rates(other._rates),
+      _denseWanted(other._denseWanted), _denseBase(other._denseBase),
+      _dense(other._dense), _rangesReady(0)
+{
+    pthread_mutex_init(&_rangesLock, NULL);
+    copyRanges(other);
+}
+
+PriceIndex& PriceIndex::operator=(const PriceIndex& other)
+{
+    if (this != &other)
+    {
+        _keys = other._keys;
+        _rates = other._rates;
+        _denseWanted = other._denseWanted;
+        _denseBase = other._denseBase;
+        _dense = other._dense;
+        copyRanges(other);
+    }
+    return *this;
+}
+
+PriceIndex::~PriceIndex()
+{
+    pthread_mutex_destroy(&_rangesLock);
+}
+
+/**
+ * Take other's range table if it was built, else leave ours to be
+ * built on demand (other may be building it right now: only a ready
+ * table is stable to copy)
+ */
+void PriceIndex::copyRanges(const PriceIndex& other)
+{
+    if (__atomic_load_n(&other._rangesReady, __ATOMIC_ACQUIRE))
+    {
+        _ranges = other._ranges;
+        _rangesReady = 1;
+    }
+    else
+    {
+        _rangesReady = 0;
+        _ranges.clear();
+    }
+}
+
+/**
+ * Build sorted parallel arrays
+ *
+ * Three strategies, all "last duplicate wins":
+ * - Input already in date order (the usual CSV): one linear pass
+ * - Large unordered input: direct-address table over DateKey::KEY_SPACE,
+ *   O(n + KEY_SPACE) and no comparisons
+ * - Small unordered input: stable_sort keeps duplicates in file order,
+ *   so the last entry of each run of equal keys is the newest one
+ */
+void PriceIndex::build(std::vector<Entry>& entries)
+{
+    bool sorted = true;
+    for (size_t i = 1; i < entries.size() && sorted; i++)
+        sorted = (entries[i - 1].key <= entries[i].key);
+
+    if (!sorted && entries.size() >= DateKey::KEY_SPACE / 4)
+    {
+        buildDirect(entries);
+        return;
+    }
+    if (!sorted)
+        std::stable_sort(entries.begin(), entries.end(), Helpers::entryKeyLess);
+
+    std::vector<uint32_t> keys;
+    std::vector<float> rates;
+    keys.reserve(entries.size());
+    rates.reserve(entries.size());
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (!keys.empty() && keys.back() == entries[i].key)
+        {
+            rates.back() = entries[i].rate;
+            continue;
+        }
+        keys.push_back(entries[i].key);
+        rates.push_back(entries[i].rate);
+    }
+
+    _keys.swap(keys);
+    _rates.swap(rates);
+    refreshTables();
+}
+
+void PriceIndex::buildDirect(const std::vector<Entry>& entries)
+{
+    std::vector<float> table(DateKey::KEY_SPACE);
+    std::vector<bool> present(DateKey::KEY_SPACE, false);
+    size_t count = 0;
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        uint32_t key = entries[i].key;
+        if (!present[key])
+        {
+            present[key] = true;
+            count++;
+        }
+        table[key] = entries[i].rate;
+    }
+
+    std::vector<uint32_t> keys;
+    std::vector<float> rates;
+    keys.reserve(count);
+    rates.reserve(count);
+    for (uint32_t key = 0; key < DateKey::KEY_SPACE; key++)
+    {
+        if (!present[key])
+            continue;
+        keys.push_back(key);
+        rates.push_back(table[key]);
+    }
+
+    _keys.swap(keys);
+    _rates.swap(rates);
+    refreshTables();
+}
+
+bool PriceIndex::assign(const uint32_t* keys, const float* rates, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (keys[i] >= DateKey::KEY_SPACE || (i > 0 && keys[i - 1] >= keys[i]))
+            return false;
+    }
+
+    std::vector<uint32_t>(keys, keys + count).swap(_keys);
+    std::vector<float>(rates, rates + count).swap(_rates);
+    refreshTables();
+    return true;
+}
+
+/**
+ * Incremental update
+ *
+ * 1. stable_sort the updates (k rows, k log k) and keep the last of
+ *    each run of equal keys
+ * 2. Merge with base's sorted arrays; on equal keys the update wins
+ *
+ * Appending newer dates is the common case: the merge then copies base
+ * and appends, O(n + k).
+ */
+void PriceIndex::assignMerged(const PriceIndex& base, std::vector<Entry>& updates,
+                              const uint32_t* dropKey)
+{
+    bool sorted = true;
+    for (size_t i = 1; i < updates.size() && sorted; i++)
+        sorted = (updates[i - 1].key <= updates[i].key);
+    if (!sorted)
+        std::stable_sort(updates.begin(), updates.end(), Helpers::entryKeyLess);
+
+    std::vector<uint32_t> keys;
+    std::vector<float> rates;
+    keys.reserve(base._keys.size() + updates.size());
+    rates.reserve(base._keys.size() + updates.size());
+
+    size_t row = 0;
+    size_t rows = base._keys.size();
+    for (size_t i = 0; i < updates.size(); i++)
+    {
+        // Last duplicate of the run wins
+        if (i + 1 < updates.size() && updates[i + 1].key == updates[i].key)
+            continue;
+        uint32_t key = updates[i].key;
+        while (row < rows && base._keys[row] < key)
+        {
+            if (!dropKey || base._keys[row] != *dropKey)
+            {
+                keys.push_back(base._keys[row]);
+                rates.push_back(base._rates[row]);
+            }
+            row++;
+        }
+        if (row < rows && base._keys[row] == key)
+            row++;
+        keys.push_back(key);
+        rates.push_back(updates[i].rate);
+    }
+    for (; row < rows; row++)
+    {
+        if (!dropKey || base._keys[row] != *dropKey)
+        {
+            keys.push_back(base._keys[row]);
+            rates.push_back(base._rates[row]);
+        }
+    }
+
+    _keys.swap(keys);
+    _rates.swap(rates);
+    _denseWanted = base._denseWanted;
+    refreshTables();
+}
+
+/**
+ * Last row with a key <= key
+ * Precondition: index not empty and _keys[0] <= key
+ */
+size_t PriceIndex::lowerOrEqual(uint32_t key) const
+{
+    return Helpers::lowerOrEqual(&_keys[0], _keys.size(), key);
+}
+
+/**
+ * lowerOrEqual(key), galloping from the row of a previous answer
+ * Precondition: as lowerOrEqual, and row < size()
+ *
+ * Keys are distinct day numbers, so the answer is at most
+ * |key - _keys[row]| rows from row: a key further than FINGER_MAX_GAP
+ * days goes straight to the full search instead of galloping.
+ *
+ * Forward (_keys[row] <= key): move lo by 1, 2, 4, ... while the key
+ * there is still <= key; the answer is then in [lo, lo + step).
+ * Backward: move hi down the same way while the key is still > key;
+ * the answer is in [hi - step, hi). Either way a window of at most
+ * `step` rows is left for the binary search.
+ */
+size_t PriceIndex::fingerRow(size_t row, uint32_t key) const
+{
+    const uint32_t* keys = &_keys[0];
+    size_t n = _keys.size();
+    size_t step = 1;
+    uint32_t at = keys[row];
+
+    if ((key > at ? key - at : at - key) > FINGER_MAX_GAP)
+        return lowerOrEqual(key);
+
+    if (at <= key)
+    {
+        size_t lo = row;
+        while (lo + step < n && keys[lo + step] <= key)
+        {
+            lo += step;
+            step *= 2;
+        }
+        return lo + Helpers::lowerOrEqual(keys + lo, std::min(step, n - lo), key);
+    }
+
+    size_t hi = row;
+    while (hi >= step && keys[hi - step] > key)
+    {
+        hi -= step;
+        step *= 2;
+    }
+    size_t lo = (hi >= step) ? hi - step : 0;
+    return lo + Helpers::lowerOrEqual(keys + lo, hi - lo, key);
+}
+
+PriceIndex::Cursor::Cursor(const PriceIndex& index) : _index(&index), _row(0)
+{
+}
+
+bool PriceIndex::Cursor::findRate(uint32_t key, float& rate)
+{
+    const PriceIndex& index = *_index;
+    if (index._keys.empty() || key < index._keys[0])
+        return false;
+
+    _row = index.fingerRow(_row, key);
+    rate = index._rates[_row];
+    return true;
+}
+
+bool PriceIndex::findRate(uint32_t key, float& rate) const
+{
+    if (_keys.empty() || key < _keys[0])
+        return false;
+
+    if (!_dense.empty())
+    {
+        size_t slot = key - _denseBase;
+        rate = (slot < _dense.size()) ? _dense[slot] : _rates.back();
+        return true;
+    }
+
+    rate = _rates[lowerOrEqual(key)];
+    return true;
+}
+
+bool PriceIndex::findExact(uint32_t key, float& rate) const
+{
+    if (_keys.empty() || key < _keys[0])
+        return false;
+
+    size_t row = lowerOrEqual(key);
+    if (_keys[row] != key)
+        return false;
+    rate = _rates[row];
+    return true;
+}
+
+bool PriceIndex::findRange(uint32_t from, uint32_t to, RangeTable::Stats& stats) const
+{
+    if (_keys.empty() || from > to || to < _keys[0])
+        return false;
+
+    if (!__atomic_load_n(&_rangesReady, __ATOMIC_ACQUIRE))
+        buildRanges();
+    size_t first = (from < _keys[0]) ? 0 : lowerOrEqual(from);
+    _ranges.query(first, lowerOrEqual(to), stats);
+    return true;
+}
+
+/**
+ * Whether 3/4 of the neighbouring keys are at most LOCALITY_NEAR_KEYS
+ * apart (one sequential pass)
+ */
+static bool hasLocality(const uint32_t* keys, size_t n)
+{
+    size_t near = 0;
+    for (size_t i = 1; i < n; i++)
+    {
+        uint32_t gap = (keys[i] > keys[i - 1]) ? keys[i] - keys[i - 1] : keys[i - 1] - keys[i];
+        near += (gap <= PriceIndex::LOCALITY_NEAR_KEYS);
+    }
+    return n > 1 && near * 4 >= (n - 1) * 3;
+}
+
+/**
+ * A batch without locality in the merge window goes to mergeRates.
+ * Otherwise each block is checked for locality to choose the cursor
+ * or the interleaved search; the cursor carries over between blocks.
+ */
+void PriceIndex::findRates(const uint32_t* keys, size_t count,
+                           float* rates, unsigned char* found) const
+{
+    if (!_dense.empty())
+    {
+        for (size_t i = 0; i < count; i++)
+            found[i] = findRate(keys[i], rates[i]);
+        return;
+    }
+
+    if (_keys.size() >= MERGE_MIN_ROWS && count <= MERGE_MAX_BATCH
+        && _keys.size() <= count * MERGE_MAX_ROWS_PER_QUERY && !hasLocality(keys, count))
+    {
+        mergeRates(keys, count, rates, found);
+        return;
+    }
+
+    Cursor cursor(*this);
+    for (size_t first = 0; first < count; first += LOCALITY_BLOCK)
+    {
+        size_t n = (count - first < LOCALITY_BLOCK) ? count - first : LOCALITY_BLOCK;
+        const uint32_t* block = keys + first;
+
+        if (hasLocality(block, n))
+        {
+            for (size_t i = 0; i < n; i++)
+                found[first + i] = cursor.findRate(block[i], rates[first + i]);
+        }
+        else
+            InterleavedSearch::findRates(_keys.empty() ? NULL : &_keys[0],
+                                         _rates.empty() ? NULL : &_rates[0], _keys.size(),
+                                         block, n, rates + first, found + first);
+    }
+}
+
+/**
+ * Sort-merge as-of join
+ *
+ * 1. Pack each query as (key << 32 | position) and LSD radix sort on the
+ *    key bits: DateKey keys are < 2^19, so two 10-bit passes suffice
+ * 2. Walk queries and _keys together; `row` only moves forward
+ * 3. Write each answer to its original position
+ */
+void PriceIndex::mergeRates(const uint32_t* keys, size_t count,
+                            float* rates, unsigned char* found) const
+{
+    const unsigned int RADIX_BITS = 10;
+    const size_t BUCKETS = 1 << RADIX_BITS;
+
+    std::vector<uint64_t> items(count);
+    std::vector<uint64_t> sorted(count);
+    for (size_t i = 0; i < count; i++)
+        items[i] = (static_cast<uint64_t>(keys[i]) << 32) | i;
+
+    for (unsigned int shift = 32; shift < 32 + 2 * RADIX_BITS; shift += RADIX_BITS)
+    {
+        size_t offsets[BUCKETS + 1];
+        std::fill(offsets, offsets + BUCKETS + 1, 0);
+        for (size_t i = 0; i < count; i++)
+            offsets[((items[i] >> shift) & (BUCKETS - 1)) + 1]++;
+        for (size_t b = 0; b < BUCKETS; b++)
+            offsets[b + 1] += offsets[b];
+        for (size_t i = 0; i < count; i++)
+            sorted[offsets[(items[i] >> shift) & (BUCKETS - 1)]++] = items[i];
+        items.swap(sorted);
+    }
+
+    size_t row = 0;
+    size_t rows = _keys.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t key = static_cast<uint32_t>(items[i] >> 32);
+        size_t pos = static_cast<size_t>(items[i] & 0xffffffffu);
+
+        // Advance to the last row with _keys[row] <= key
+        while (row + 1 < rows && _keys[row + 1] <= key)
+            row++;
+
+        if (rows == 0 || _keys[row] > key)
+            found[pos] = 0;
+        else
+        {
+            found[pos] = 1;
+            rates[pos] = _rates[row];
+        }
+    }
+}
+
+void PriceIndex::setDenseLookup(bool enabled)
+{
+    _denseWanted = enabled;
+    refreshDense();
+}
+
+bool PriceIndex::isDense() const
+{
+    return !_dense.empty();
+}
+
+/**
+ * Rebuild everything derived from the arrays (after they change);
+ * the range table is only dropped, findRange rebuilds it when needed
+ */
+void PriceIndex::refreshTables()
+{
+    _rangesReady = 0;
+    _ranges.clear();
+    refreshDense();
+}
+
+/**
+ * First findRange since the rows changed: build the range table once,
+ * even when several threads get here together
+ */
+void PriceIndex::buildRanges() const
+{
+    pthread_mutex_lock(&_rangesLock);
+    if (!_rangesReady)
+    {
+        _ranges.build(rates(), _rates.size());
+        __atomic_store_n(&_rangesReady, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&_rangesLock);
+}
+
+/**
+ * (Re)build the forward-filled table if wanted and compact enough
+ *
+ * Example: keys {10, 13}, rates {1.0, 2.0}
+ *   _denseBase = 10, _dense = [1.0, 1.0, 1.0, 2.0]
+ */
+void PriceIndex::refreshDense()
+{
+    std::vector<float>().swap(_dense);
+    _denseBase = 0;
+
+    if (!_denseWanted || _keys.empty())
+        return;
+
+    size_t span = static_cast<size_t>(_keys.back() - _keys[0]) + 1;
+    if (span > _keys.size() * DENSE_MAX_SPAN_PER_ROW)
+        return;
+
+    _denseBase = _keys[0];
+    _dense.resize(span);
+    size_t row = 0;
+    for (size_t slot = 0; slot < span; slot++)
+    {
+        if (row + 1 < _keys.size() && _keys[row + 1] - _denseBase == slot)
+            row++;
+        _dense[slot] = _rates[row];
+    }
+}
+
+bool PriceIndex::empty() const
+{
+    return _keys.empty();
+}
+
+size_t PriceIndex::size() const
+{
+    return _keys.size();
+}
+
+const uint32_t* PriceIndex::keys() const
+{
+    return _keys.empty() ? NULL : &_keys[0];
+}
+
+const float* PriceIndex::rates() const
+{
+    return _rates.empty() ? NULL : &_rates[0];
+}
+
+/**
+ * Bytes used by the row data (keys + rates + dense and range tables,
+ * the range table only once a range query built it)
+ */
+size_t PriceIndex::memoryUsage() const
+{
+    return _keys.capacity() * sizeof(uint32_t) + _rates.capacity() * sizeof(float)
+         + _dense.capacity() * sizeof(float) + _ranges.memoryUsage();
+}
@@ -0,0 +1,202 @@
+#ifndef PRICE_INDEX_HPP
+#define PRICE_INDEX_HPP
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include <pthread.h>
+#include "RangeTable.hpp"
+
+/**
+ * PriceIndex: immutable, packed date -> rate index
+ *
+ * Layout (structure of arrays):
+ *   _keys:  [k0, k1, k2, ...]   sorted 32-bit day numbers (see DateKey)
+ *   _rates: [r0, r1, r2, ...]   rate for _keys[i]
+ *
+ * Why not std::map<std::string, float>?
+ * - A map entry is a heap node + a heap string (~90 bytes per row)
+ * - Lookups chase pointers and compare strings
+ * - Here a row costs 8 bytes and a lookup touches one contiguous array
+ *
+ * Lookups use a branchless binary search: the loop always runs
+ * log2(n) steps and the compiler turns the comparison into a cmov,
+ * so there are no mispredicted branches.
+ *
+ * Optional dense mode (setDenseLookup):
+ *   _dense[k - _denseBase] = rate of the closest key <= k
+ * for every k between the first and last key, so a lookup is a single
+ * load. It is only built while the table stays small: at most
+ * DENSE_MAX_SPAN_PER_ROW slots per stored row (2x the packed arrays).
+ * Sparser data silently keeps using the binary search.
+ *
+ * Range aggregates (findRange) come from a RangeTable: O(1) sums,
+ * O(log n) min/max, 24 more bytes per row. It is built by the first
+ * findRange after the rows change (under a lock, so concurrent readers
+ * build it once), so indexes never queried by range never pay for it.
+ */
+class PriceIndex
+{
+public:
+    struct Entry
+    {
+        uint32_t key;
+        float rate;
+    };
+
+    static const size_t DENSE_MAX_SPAN_PER_ROW = 4;
+    // Cursor gallops only to keys at most this many days away
+    static const uint32_t FINGER_MAX_GAP = 256;
+    // findRates picks its strategy per block of this many queries...
+    static const size_t LOCALITY_BLOCK = 256;
+    // ...using the cursor when 3/4 of the neighbours are this close
+    static const uint32_t LOCALITY_NEAR_KEYS = 64;
+    // Batches without locality use mergeRates when the index is too
+    // big for the cache to make searches cheap...
+    static const size_t MERGE_MIN_ROWS = 65536;
+    // ...the batch is big enough to amortize walking all rows...
+    static const size_t MERGE_MAX_ROWS_PER_QUERY = 8;
+    // ...and small enough for the radix sort to stay in cache
+    static const size_t MERGE_MAX_BATCH = 65536;
+
+    /**
+     * Finger search for query streams with locality (sorted, reverse
+     * sorted or clustered dates): remembers the row of the last answer
+     * and gallops from there, 1, 2, 4, ... rows in the right direction,
+     * then binary searches the last step.
+     *   same date again   O(1)
+     *   d rows away       O(log d)
+     *   far away          one full search (over FINGER_MAX_GAP days)
+     * One cursor per thread; it must not outlive its index.
+     */
+    class Cursor
+    {
+    private:
+        const PriceIndex* _index;
+        size_t _row;
+
+    public:
+        explicit Cursor(const PriceIndex& index);
+
+        /**
+         * Same answer as PriceIndex::findRate
+         */
+        bool findRate(uint32_t key, float& rate);
+    };
+
+private:
+    std::vector<uint32_t> _keys;
+    std::vector<float> _rates;
+
+    // Forward-filled table for dense mode (empty when not in use)
+    bool _denseWanted;
+    uint32_t _denseBase;
+    std::vector<float> _dense;
+
+    // Prefix sums and min/max trees over _rates, valid once _rangesReady
+    mutable RangeTable _ranges;
+    mutable int _rangesReady;
+    mutable pthread_mutex_t _rangesLock;
+
+    size_t lowerOrEqual(uint32_t key) const;
+    size_t fingerRow(size_t row, uint32_t key) const;
+    void buildDirect(const std::vector<Entry>& entries);
+    void refreshDense();
+    void refreshTables();
+    void copyRanges(const PriceIndex& other);
+    void buildRanges() const;
+
+public:
+    PriceIndex();
+    PriceIndex(const PriceIndex& other);
+    PriceIndex& operator=(const PriceIndex& other);
+    ~PriceIndex();
+
+    /**
+     * Build the index from unordered entries.
+     * Entries are sorted by key; for duplicate keys the entry that
+     * appears last wins (same as map[date] = rate while reading the CSV).
+     * The input vector may be reordered.
+     */
+    void build(std::vector<Entry>& entries);
+
+    /**
+     * Replace the contents with already sorted arrays (e.g. a snapshot)
+     * Returns false, leaving the index unchanged, unless keys are
+     * strictly increasing and inside DateKey::KEY_SPACE
+     */
+    bool assign(const uint32_t* keys, const float* rates, size_t count);
+
+    /**
+     * Replace the contents with `base` plus `updates` (rows read after
+     * base was built, in file order: they win over base rows and over
+     * earlier updates with the same key)
+     * Only the updates are sorted; base is merged in one linear pass,
+     * so late or corrected dates never re-sort the whole history.
+     * A base row with key *dropKey (if given) is left out.
+     * The updates vector may be reordered. `base` must not be *this.
+     */
+    void assignMerged(const PriceIndex& base, std::vector<Entry>& updates,
+                      const uint32_t* dropKey);
+
+    /**
+     * Find the rate of the closest date <= key
+     * Returns false when every date in the index is after key
+     */
+    bool findRate(uint32_t key, float& rate) const;
+
+    /**
+     * Rate stored for exactly this key (false if the date is not a row)
+     */
+    bool findExact(uint32_t key, float& rate) const;
+
+    /**
+     * Aggregate the rates in effect from date `from` to date `to`:
+     * the rows dated in [from, to], plus the row in effect on `from`
+     * (its closest lower date) when `from` itself is not a row.
+     * O(log n), plus O(n) once for the first call after the rows
+     * change (see RangeTable). Returns false when no rate is in
+     * effect by `to` (or from > to).
+     */
+    bool findRange(uint32_t from, uint32_t to, RangeTable::Stats& stats) const;
+
+    /**
+     * Batch form of findRate: for each i, found[i] = findRate(keys[i], rates[i])
+     *
+     * A batch without locality, between MERGE_MIN_ROWS and
+     * MERGE_MAX_ROWS_PER_QUERY rows per query and at most
+     * MERGE_MAX_BATCH keys, is resolved by mergeRates. Otherwise each
+     * block of LOCALITY_BLOCK keys is checked for locality. Blocks
+     * whose neighbouring keys are mostly close (sorted or clustered
+     * input) go through a Cursor. The others run interleaved
+     * (InterleavedSearch): groups of queries advance in lockstep with
+     * their next probes prefetched, so their cache misses overlap.
+     * Dense mode just reads the table per query.
+     */
+    void findRates(const uint32_t* keys, size_t count,
+                   float* rates, unsigned char* found) const;
+
+    /**
+     * Same answers as findRates, as a sort-merge as-of join: the
+     * queries are radix sorted by key (keeping their positions),
+     * resolved by one linear walk over the keys and scattered back
+     * into input order
+     */
+    void mergeRates(const uint32_t* keys, size_t count,
+                    float* rates, unsigned char* found) const;
+
+    /**
+     * Request O(1) calendar-table lookups
+     * isDense() tells whether the table was actually built
+     */
+    void setDenseLookup(bool enabled);
+    bool isDense() const;
+
+    bool empty() const;
+    size_t size() const;
+    const uint32_t* keys() const;
+    const float* rates() const;
+    size_t memoryUsage() const;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "RangeTable.hpp"
+#include <algorithm>
+
+RangeTable::RangeTable() : _rows(0)
+{
+}
+
+RangeTable::RangeTable(const RangeTable& other)
+    : _rows(other._rows), _prefix(other._prefix), _min(other._min), _max(other._max)
+{
+}
+
+RangeTable& RangeTable::operator=(const RangeTable& other)
+{
+    if (this != &other)
+    {
+        _rows = other._rows;
+        _prefix = other._prefix;
+        _min = other._min;
+        _max = other._max;
+    }
+    return *this;
+}
+
+RangeTable::~RangeTable()
+{
+}
+
+void RangeTable::build(const float* rates, size_t count)
+{
+    _rows = count;
+    std::vector<double> prefix(count + 1);
+    std::vector<float> mins(count * 2);
+    std::vector<float> maxs(count * 2);
+
+    prefix[0] = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        prefix[i + 1] = prefix[i] + rates[i];
+        mins[count + i] = rates[i];
+        maxs[count + i] = rates[i];
+    }
+    for (size_t i = count; i-- > 1; )
+    {
+        mins[i] = std::min(mins[2 * i], mins[2 * i + 1]);
+        maxs[i] = std::max(maxs[2 * i], maxs[2 * i + 1]);
+    }
+
+    _prefix.swap(prefix);
+    _min.swap(mins);
+    _max.swap(maxs);
+}
+
+void RangeTable::clear()
+{
+    _rows = 0;
+    std::vector<double>().swap(_prefix);
+    std::vector<float>().swap(_min);
+    std::vector<float>().swap(_max);
+}
+
+/**
+ * Walk the half-open leaf range [lo, hi) up the trees: whenever a bound
+ * is a right child (lo) or a left child's successor (hi), that node is
+ * fully inside the range and is folded in before moving to the parents
+ */
+void RangeTable::query(size_t first, size_t last, Stats& stats) const
+{
+    stats.count = last - first + 1;
+    stats.sum = _prefix[last + 1] - _prefix[first];
+    stats.min = _min[_rows + first];
+    stats.max = _max[_rows + first];
+
+    for (size_t lo = first + _rows, hi = last + 1 + _rows; lo < hi; lo /= 2, hi /= 2)
+    {
+        if (lo & 1)
+        {
+            stats.min = std::min(stats.min, _min[lo]);
+            stats.max = std::max(stats.max, _max[lo]);
+            lo++;
+        }
+        if (hi & 1)
+        {
+            hi--;
+            stats.min = std::min(stats.min, _min[hi]);
+            stats.max = std::max(stats.max, _max[hi]);
+        }
+    }
+}
+
+size_t RangeTable::memoryUsage() const
+{
+    return _prefix.capacity() * sizeof(double)
+         + (_min.capacity() + _max.capacity()) * sizeof(float);
+}
@@ -0,0 +1,57 @@
+#ifndef RANGE_TABLE_HPP
+#define RANGE_TABLE_HPP
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * RangeTable: min / max / sum of any run of rows of a rate array
+ *
+ * Built over PriceIndex's sorted rates (O(n)) on its first range query:
+ *   _prefix[i]   sum of rates[0 .. i) in double, so a sum is
+ *                _prefix[hi] - _prefix[lo]            O(1)
+ *   _min, _max   bottom-up segment trees: leaves at [n, 2n), node i
+ *                combines nodes 2i and 2i+1            O(log n)
+ *
+ * A sparse table would answer min/max in O(1) but costs
+ * log2(n) floats per row; the trees cost 2 floats per row each.
+ */
+class RangeTable
+{
+public:
+    struct Stats
+    {
+        size_t count;
+        float min;
+        float max;
+        double sum;
+    };
+
+private:
+    size_t _rows;
+    std::vector<double> _prefix;
+    std::vector<float> _min;
+    std::vector<float> _max;
+
+public:
+    RangeTable();
+    RangeTable(const RangeTable& other);
+    RangeTable& operator=(const RangeTable& other);
+    ~RangeTable();
+
+    void build(const float* rates, size_t count);
+
+    /**
+     * Drop the table and free its memory
+     */
+    void clear();
+
+    /**
+     * Stats of rows [first, last] (requires first <= last < rows)
+     */
+    void query(size_t first, size_t last, Stats& stats) const;
+
+    size_t memoryUsage() const;
+};
+
+#endif
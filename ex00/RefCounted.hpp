@@ -0,0 +1,53 @@
+#ifndef REF_COUNTED_HPP
+#define REF_COUNTED_HPP
+
+/**
+ * RefCounted<T>: manual, thread-safe shared ownership of an immutable
+ * T between BitcoinExchange copies (T derives from RefCounted<T>)
+ *
+ *   new T          holds one reference
+ *   T::retain(p)   adds one (NULL is allowed) and returns p
+ *   T::release(p)  drops one and deletes p on the last (NULL is allowed)
+ *
+ * A copy of the base starts with a count of its own, never the source's.
+ */
+template <typename T>
+class RefCounted
+{
+private:
+    mutable long _refs;
+
+protected:
+    RefCounted() : _refs(1)
+    {
+    }
+
+    RefCounted(const RefCounted&) : _refs(1)
+    {
+    }
+
+    RefCounted& operator=(const RefCounted&)
+    {
+        return *this;
+    }
+
+    ~RefCounted()
+    {
+    }
+
+public:
+    static const T* retain(const T* object)
+    {
+        if (object)
+            __sync_fetch_and_add(&object->_refs, 1);
+        return object;
+    }
+
+    static void release(const T* object)
+    {
+        if (object && __sync_sub_and_fetch(&object->_refs, 1) == 0)
+            delete object;
+    }
+};
+
+#endif
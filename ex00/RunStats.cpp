@@ -0,0 +1,121 @@
+#include "RunStats.hpp"
+
+#ifdef BTC_STATS
+
+#include <iomanip>
+#include <time.h>
+
+static const char* const STAGE_NAMES[RunStats::STAGE_COUNT] = {
+    "load", "open", "parse", "lookup", "format", "output", "total"
+};
+
+static const char* const OUTCOME_NAMES[RunStats::OUTCOME_COUNT] = {
+    "result", "no_rate", "empty", "no_separator", "bad_date",
+    "bad_value", "bad_assets", "negative", "too_large"
+};
+
+RunStats::Clock::Clock() : _last(RunStats::nowNanos())
+{
+}
+
+void RunStats::Clock::lap(RunStats& stats, Stage stage)
+{
+    uint64_t now = RunStats::nowNanos();
+    stats.stageNanos[stage] += now - _last;
+    _last = now;
+}
+
+RunStats::RunStats()
+{
+    clear();
+}
+
+void RunStats::clear()
+{
+    for (size_t i = 0; i < STAGE_COUNT; i++)
+        stageNanos[i] = 0;
+    for (size_t i = 0; i < OUTCOME_COUNT; i++)
+        lines[i] = 0;
+    lookups = 0;
+    chunks = 0;
+    bytesIn = 0;
+    bytesOut = 0;
+    databaseRows = 0;
+}
+
+void RunStats::add(Outcome outcome)
+{
+    lines[outcome]++;
+}
+
+void RunStats::merge(const RunStats& other)
+{
+    for (size_t i = 0; i < STAGE_COUNT; i++)
+        __sync_fetch_and_add(&stageNanos[i], other.stageNanos[i]);
+    for (size_t i = 0; i < OUTCOME_COUNT; i++)
+        __sync_fetch_and_add(&lines[i], other.lines[i]);
+    __sync_fetch_and_add(&lookups, other.lookups);
+    __sync_fetch_and_add(&chunks, other.chunks);
+    __sync_fetch_and_add(&bytesIn, other.bytesIn);
+    __sync_fetch_and_add(&bytesOut, other.bytesOut);
+    __sync_fetch_and_add(&databaseRows, other.databaseRows);
+}
+
+uint64_t RunStats::nowNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+/**
+ * Human form (times in ms):
+ *   lines           3000000
+ *     result        1493513
+ *     ...
+ *   time (ms)       load 0.156 open 17.227 parse 308.645 ...
+ */
+void RunStats::print(std::ostream& out, bool json) const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < OUTCOME_COUNT; i++)
+        total += lines[i];
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    if (json)
+    {
+        out << "{\"lines\":" << total;
+        for (size_t i = 0; i < OUTCOME_COUNT; i++)
+            out << ",\"" << OUTCOME_NAMES[i] << "\":" << lines[i];
+        out << ",\"lookups\":" << lookups << ",\"chunks\":" << chunks
+            << ",\"bytes_in\":" << bytesIn << ",\"bytes_out\":" << bytesOut
+            << ",\"database_rows\":" << databaseRows << ",\"ms\":{";
+        for (size_t i = 0; i < STAGE_COUNT; i++)
+            out << (i ? "," : "") << '"' << STAGE_NAMES[i] << "\":" << stageNanos[i] / 1e6;
+        out << "}}" << std::endl;
+    }
+    else
+    {
+        out << "lines           " << total << '\n';
+        for (size_t i = 0; i < OUTCOME_COUNT; i++)
+            out << "  " << std::left << std::setw(14) << OUTCOME_NAMES[i]
+                << std::right << lines[i] << '\n';
+        out << "lookups         " << lookups << '\n'
+            << "chunks          " << chunks << '\n'
+            << "bytes in        " << bytesIn << '\n'
+            << "bytes out       " << bytesOut << '\n'
+            << "database rows   " << databaseRows << '\n'
+            << "time (ms)      ";
+        for (size_t i = 0; i < STAGE_COUNT; i++)
+            out << ' ' << STAGE_NAMES[i] << ' ' << stageNanos[i] / 1e6;
+        out << std::endl;
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef RUN_STATS_HPP
+#define RUN_STATS_HPP
+
+#include <ostream>
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * Instrumentation points compile to nothing unless BTC_STATS is defined
+ * (the Makefile defines it unless built with STATS=0):
+ *   BTC_STATS_ONLY(stats.add(RunStats::OUTCOME_EMPTY);)
+ */
+#ifdef BTC_STATS
+# define BTC_STATS_ONLY(code) code
+#else
+# define BTC_STATS_ONLY(code)
+#endif
+
+/**
+ * RunStats: counters and stage timers of one btc run (--stats)
+ *
+ * Each worker thread counts into its own RunStats (no sharing on the
+ * hot path) and merges it into the run's totals once per round. Stage
+ * times are taken per chunk, not per line, so the cost is a few clock
+ * reads per megabyte of input. With several threads the parse, lookup
+ * and format times add up the time of every thread.
+ */
+class RunStats
+{
+public:
+    enum Stage
+    {
+        STAGE_LOAD,         // database, ticks and assets
+        STAGE_OPEN,         // opening / mapping the input, or read() when streaming
+        STAGE_PARSE,        // splitting and validating lines
+        STAGE_LOOKUP,       // rate, range, asset and tick lookups
+        STAGE_FORMAT,       // building the output text
+        STAGE_OUTPUT,       // writing it to stdout
+        STAGE_TOTAL,        // processInputFile, wall clock
+        STAGE_COUNT
+    };
+
+    /**
+     * What became of an input line
+     */
+    enum Outcome
+    {
+        OUTCOME_RESULT,         // a value (or range, assets) was printed
+        OUTCOME_NO_RATE,        // valid, but no rate on or before the date
+        OUTCOME_EMPTY,
+        OUTCOME_NO_SEPARATOR,   // bad input: no '|'
+        OUTCOME_BAD_DATE,       // bad input: date (or timestamp, range) invalid
+        OUTCOME_BAD_VALUE,      // bad input: value is not a number
+        OUTCOME_BAD_ASSETS,     // bad input: unknown asset name
+        OUTCOME_NEGATIVE,
+        OUTCOME_TOO_LARGE,
+        OUTCOME_COUNT
+    };
+
+    uint64_t stageNanos[STAGE_COUNT];
+    uint64_t lines[OUTCOME_COUNT];
+    uint64_t lookups;
+    uint64_t chunks;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t databaseRows;
+
+    /**
+     * Stopwatch: lap() charges the time since the last lap to a stage
+     */
+    class Clock
+    {
+    private:
+        uint64_t _last;
+
+    public:
+        Clock();
+        void lap(RunStats& stats, Stage stage);
+    };
+
+    RunStats();
+
+    void clear();
+    void add(Outcome outcome);
+
+    /**
+     * Add other into this; safe against concurrent merges
+     */
+    void merge(const RunStats& other);
+
+    static uint64_t nowNanos();
+
+    /**
+     * Summary for humans, or one JSON object
+     */
+    void print(std::ostream& out, bool json) const;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "Snapshot.hpp"
+#include "MappedFile.hpp"
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+static const char SNAPSHOT_MAGIC[8] = { 'B', 'T', 'C', 'S', 'N', 'A', 'P', '\0' };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+std::string Snapshot::pathFor(const std::string& csv_path)
+{
+    return csv_path + ".snap";
+}
+
+void Snapshot::fillSource(Header& header, const struct stat& source)
+{
+    header.sourceSize = static_cast<uint64_t>(source.st_size);
+    header.sourceMtimeSec = static_cast<int64_t>(source.st_mtim.tv_sec);
+    header.sourceMtimeNsec = static_cast<int64_t>(source.st_mtim.tv_nsec);
+}
+
+/**
+ * FNV-1a over 32-bit words of keys, then rates
+ */
+uint64_t Snapshot::checksum(const uint32_t* keys, const float* rates, size_t count)
+{
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < count; i++)
+        hash = (hash ^ keys[i]) * prime;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &rates[i], sizeof(bits));
+        hash = (hash ^ bits) * prime;
+    }
+    return hash;
+}
+
+bool Snapshot::read(const std::string& path, const struct stat& source, PriceIndex& index)
+{
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    Header expected;
+    fillSource(expected, source);
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+        || header.version != VERSION
+        || header.byteOrder != BYTE_ORDER_MARK
+        || header.sourceSize != expected.sourceSize
+        || header.sourceMtimeSec != expected.sourceMtimeSec
+        || header.sourceMtimeNsec != expected.sourceMtimeNsec)
+        return false;
+
+    size_t payload = file.size() - sizeof(Header);
+    if (header.count > payload / (sizeof(uint32_t) + sizeof(float))
+        || payload != header.count * (sizeof(uint32_t) + sizeof(float)))
+        return false;
+
+    size_t count = static_cast<size_t>(header.count);
+    const uint32_t* keys = reinterpret_cast<const uint32_t*>(file.data() + sizeof(Header));
+    const float* rates = reinterpret_cast<const float*>(keys + count);
+
+    if (checksum(keys, rates, count) != header.checksum)
+        return false;
+
+    return index.assign(keys, rates, count);
+}
+
+bool Snapshot::write(const std::string& path, const struct stat& source, const PriceIndex& index)
+{
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.count = index.size();
+    fillSource(header, source);
+    header.checksum = checksum(index.keys(), index.rates(), index.size());
+
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (index.size())
+    {
+        out.write(reinterpret_cast<const char*>(index.keys()), index.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(index.rates()), index.size() * sizeof(float));
+    }
+    out.close();
+
+    if (!out || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
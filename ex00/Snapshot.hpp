@@ -0,0 +1,69 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <string>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "PriceIndex.hpp"
+
+/**
+ * Snapshot: binary image of a PriceIndex, tied to the CSV it came from
+ *
+ * File layout (native byte order, 8-byte aligned):
+ *   Header      56 bytes (see below)
+ *   keys[count] uint32_t, strictly increasing DateKey day numbers
+ *   rates[count] float
+ *
+ * A snapshot is used only if:
+ * - magic, version and byte-order marker match this build
+ * - the recorded size and mtime match the current CSV (otherwise the
+ *   CSV changed since the snapshot was written, and it is stale)
+ * - the file length matches count and the checksum over keys + rates
+ *   is correct
+ *
+ * Loading maps the file and copies the two arrays: no text parsing.
+ * Writing goes to "<path>.tmp" and is renamed over <path>, so readers
+ * never see a half-written snapshot.
+ */
+class Snapshot
+{
+public:
+    static const uint32_t VERSION = 1;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t count;
+        uint64_t sourceSize;
+        int64_t sourceMtimeSec;
+        int64_t sourceMtimeNsec;
+        uint64_t checksum;
+    };
+
+private:
+    Snapshot();
+
+    static void fillSource(Header& header, const struct stat& source);
+    static uint64_t checksum(const uint32_t* keys, const float* rates, size_t count);
+
+public:
+    /**
+     * Snapshot path used for a CSV file: "<csv>.snap"
+     */
+    static std::string pathFor(const std::string& csv_path);
+
+    /**
+     * Load a fresh, valid snapshot of `source` into index
+     * Returns false (index unchanged) if missing, stale or corrupt
+     */
+    static bool read(const std::string& path, const struct stat& source, PriceIndex& index);
+
+    /**
+     * Write index as the snapshot of `source`
+     */
+    static bool write(const std::string& path, const struct stat& source, const PriceIndex& index);
+};
+
+#endif
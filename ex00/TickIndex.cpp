@@ -0,0 +1,197 @@
+#include "TickIndex.hpp"
+#include "Timestamp.hpp"
+#include "MappedFile.hpp"
+#include "FloatParser.hpp"
+#include "Helpers.hpp"
+#include <algorithm>
+#include <cstring>
+
+static bool tickTimeLess(const TickIndex::Tick& a, const TickIndex::Tick& b)
+{
+    return a.time < b.time;
+}
+
+static void appendVarint(std::vector<unsigned char>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+static uint64_t readVarint(const unsigned char*& p)
+{
+    uint64_t value = 0;
+    unsigned int shift = 0;
+    while (*p & 0x80)
+    {
+        value |= static_cast<uint64_t>(*p++ & 0x7f) << shift;
+        shift += 7;
+    }
+    return value | (static_cast<uint64_t>(*p++) << shift);
+}
+
+TickIndex::TickIndex() : _compact(false), _count(0)
+{
+}
+
+TickIndex::~TickIndex()
+{
+}
+
+void TickIndex::setCompact(bool compact)
+{
+    _compact = compact;
+}
+
+/**
+ * Sort (skipped when already in order), drop all but the last of equal
+ * timestamps, then fill either layout block by block
+ */
+void TickIndex::build(std::vector<Tick>& ticks)
+{
+    bool sorted = true;
+    for (size_t i = 1; i < ticks.size() && sorted; i++)
+        sorted = (ticks[i - 1].time <= ticks[i].time);
+    if (!sorted)
+        std::stable_sort(ticks.begin(), ticks.end(), tickTimeLess);
+
+    size_t count = 0;
+    for (size_t i = 0; i < ticks.size(); i++)
+    {
+        if (count > 0 && ticks[count - 1].time == ticks[i].time)
+            ticks[count - 1] = ticks[i];
+        else
+            ticks[count++] = ticks[i];
+    }
+
+    std::vector<int64_t> times;
+    std::vector<float> rates(count);
+    std::vector<Block> blocks((count + BLOCK_TICKS - 1) / BLOCK_TICKS);
+    std::vector<unsigned char> deltas;
+
+    if (!_compact)
+        times.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        Block& block = blocks[i / BLOCK_TICKS];
+        rates[i] = ticks[i].rate;
+        if (!_compact)
+            times[i] = ticks[i].time;
+        if (i % BLOCK_TICKS == 0)
+        {
+            block.first = ticks[i].time;
+            block.deltaOffset = deltas.size();
+        }
+        else if (_compact)
+            appendVarint(deltas, static_cast<uint64_t>(ticks[i].time - ticks[i - 1].time));
+        block.last = ticks[i].time;
+    }
+
+    _count = count;
+    _times.swap(times);
+    _rates.swap(rates);
+    _blocks.swap(blocks);
+    std::vector<unsigned char>(deltas.begin(), deltas.end()).swap(_deltas);
+}
+
+bool TickIndex::load(const std::string& filename)
+{
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+
+    const char* p = file.data();
+    const char* end = p + file.size();
+    std::vector<Tick> ticks;
+    bool header = true;
+
+    while (p < end)
+    {
+        const char* nl = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        const char* line_end = nl ? nl : end;
+        const char* comma = static_cast<const char*>(
+            std::memchr(p, ',', static_cast<size_t>(line_end - p)));
+
+        if (!header && comma)
+        {
+            const char* time_begin = p;
+            const char* time_end = comma;
+            const char* rate_begin = comma + 1;
+            const char* rate_end = line_end;
+            Helpers::trim(time_begin, time_end);
+            Helpers::trim(rate_begin, rate_end);
+
+            Tick tick;
+            if (Timestamp::parse(time_begin, static_cast<size_t>(time_end - time_begin), tick.time)
+                && FloatParser::parse(rate_begin, static_cast<size_t>(rate_end - rate_begin), tick.rate))
+                ticks.push_back(tick);
+        }
+        header = false;
+        p = line_end + 1;
+    }
+
+    build(ticks);
+    return true;
+}
+
+/**
+ * Last block whose first time is <= time
+ * Precondition: not empty and _blocks[0].first <= time
+ */
+size_t TickIndex::findBlock(int64_t time) const
+{
+    return Helpers::lowerOrEqual(&_blocks[0], _blocks.size(), &Block::first, time);
+}
+
+bool TickIndex::findRate(int64_t time, float& rate) const
+{
+    if (_count == 0 || time < _blocks[0].first)
+        return false;
+
+    size_t b = findBlock(time);
+    const Block& block = _blocks[b];
+    size_t first = b * BLOCK_TICKS;
+    size_t last = std::min(first + BLOCK_TICKS, _count) - 1;
+
+    if (time >= block.last)
+    {
+        rate = _rates[last];
+        return true;
+    }
+
+    size_t row = first;
+    if (_compact)
+    {
+        const unsigned char* p = &_deltas[block.deltaOffset];
+        int64_t current = block.first;
+        for (;;)
+        {
+            current += static_cast<int64_t>(readVarint(p));
+            if (current > time)
+                break;
+            row++;
+        }
+    }
+    else
+        row = static_cast<size_t>(std::upper_bound(&_times[first], &_times[last], time) - &_times[0]) - 1;
+    rate = _rates[row];
+    return true;
+}
+
+size_t TickIndex::size() const
+{
+    return _count;
+}
+
+/**
+ * Bytes used by the tick data (times or deltas + rates + block table)
+ */
+size_t TickIndex::memoryUsage() const
+{
+    return _times.capacity() * sizeof(int64_t) + _rates.capacity() * sizeof(float)
+         + _blocks.capacity() * sizeof(Block) + _deltas.capacity();
+}
@@ -0,0 +1,95 @@
+#ifndef TICK_INDEX_HPP
+#define TICK_INDEX_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include "RefCounted.hpp"
+
+/**
+ * TickIndex: intraday price ticks, timestamp -> rate
+ *
+ * Timestamps are Unix epoch milliseconds (see Timestamp). Ticks are
+ * sorted and cut into blocks of BLOCK_TICKS; lookups search the block
+ * summaries first, then inside one block, with the same closest-lower
+ * semantics as PriceIndex.
+ *
+ * Plain layout (12 bytes per tick):
+ *   _times:  int64 epoch ms per tick
+ *   _rates:  float per tick
+ *   _blocks: first/last time of each block (a small, cache-resident
+ *            top level for the search)
+ *
+ * Compact layout (setCompact, about 4 + 1..3 bytes per tick):
+ *   _rates:  float per tick, as above
+ *   _blocks: first/last time of each block + offset into _deltas
+ *   _deltas: for each tick after a block's first, the gap to the
+ *            previous tick as a LEB128 varint (7 bits per byte)
+ * A lookup finds the block by its first time; a time at or after the
+ * block's last time answers with the block's last tick at once,
+ * anything else decodes at most BLOCK_TICKS - 1 varints.
+ */
+class TickIndex : public RefCounted<TickIndex>
+{
+public:
+    static const size_t BLOCK_TICKS = 128;
+
+    struct Tick
+    {
+        int64_t time;
+        float rate;
+    };
+
+private:
+    struct Block
+    {
+        int64_t first;
+        int64_t last;
+        size_t deltaOffset;
+    };
+
+    bool _compact;
+    size_t _count;
+    std::vector<int64_t> _times;
+    std::vector<float> _rates;
+    std::vector<Block> _blocks;
+    std::vector<unsigned char> _deltas;
+
+    size_t findBlock(int64_t time) const;
+
+    TickIndex(const TickIndex& other);
+    TickIndex& operator=(const TickIndex& other);
+
+public:
+    TickIndex();
+    ~TickIndex();
+
+    /**
+     * Store delta-encoded timestamps instead of the plain array
+     * (call before build or load)
+     */
+    void setCompact(bool compact);
+
+    /**
+     * Build from unordered ticks; for equal timestamps the tick that
+     * appears last wins. The input vector may be reordered.
+     */
+    void build(std::vector<Tick>& ticks);
+
+    /**
+     * Load a "timestamp,rate" CSV with a header line, skipping bad rows
+     * like loadDatabase does
+     */
+    bool load(const std::string& filename);
+
+    /**
+     * Rate of the closest tick at or before time
+     */
+    bool findRate(int64_t time, float& rate) const;
+
+    size_t size() const;
+    size_t memoryUsage() const;
+};
+
+#endif
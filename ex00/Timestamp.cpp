@@ -0,0 +1,83 @@
+#include "Timestamp.hpp"
+#include "DateKey.hpp"
+
+static const int64_t MILLIS_PER_DAY = 86400000;
+
+static bool isLeapYear(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static int daysInMonth(int year, int month)
+{
+    static const int DAYS[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return (month == 2 && isLeapYear(year)) ? 29 : DAYS[month - 1];
+}
+
+/**
+ * Two digits at str, or -1
+ */
+static int twoDigits(const char* str)
+{
+    if (str[0] < '0' || str[0] > '9' || str[1] < '0' || str[1] > '9')
+        return -1;
+    return (str[0] - '0') * 10 + (str[1] - '0');
+}
+
+/**
+ * Howard Hinnant's days_from_civil: shift the year to start in March so
+ * the leap day is last, then count 400-year eras
+ */
+int64_t Timestamp::daysFromCivil(int year, int month, int day)
+{
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return static_cast<int64_t>(era) * 146097 + doe - 719468;
+}
+
+bool Timestamp::parse(const char* str, size_t len, int64_t& millis)
+{
+    bool zulu = (len > 0 && str[len - 1] == 'Z');
+    if (zulu)
+        len--;
+
+    DateKey::Fields date;
+    if (len < 10 || !DateKey::parse(str, 10, date)
+        || date.day > daysInMonth(date.year, date.month))
+        return false;
+
+    int64_t ms = daysFromCivil(date.year, date.month, date.day) * MILLIS_PER_DAY;
+    if (len == 10)
+    {
+        // 'Z' designates the time of day: a bare date has none
+        if (zulu)
+            return false;
+        millis = ms;
+        return true;
+    }
+
+    // "THH:MM:SS" then optional ".mmm"
+    if ((len != 19 && len != 23) || (str[10] != 'T' && str[10] != ' ')
+        || str[13] != ':' || str[16] != ':')
+        return false;
+    int hour = twoDigits(str + 11);
+    int minute = twoDigits(str + 14);
+    int second = twoDigits(str + 17);
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59)
+        return false;
+    ms += ((hour * 60 + minute) * 60 + second) * 1000;
+
+    if (len == 23)
+    {
+        int hundreds = twoDigits(str + 20);
+        int last = twoDigits(str + 21);
+        if (str[19] != '.' || hundreds < 0 || last < 0)
+            return false;
+        ms += hundreds * 10 + (str[22] - '0');
+    }
+    millis = ms;
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef TIMESTAMP_HPP
+#define TIMESTAMP_HPP
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * Timestamp converts ISO-8601 date-times into Unix epoch milliseconds
+ *
+ * Accepted forms (UTC):
+ *   YYYY-MM-DD                      midnight
+ *   YYYY-MM-DDTHH:MM:SS             'T' or a single space
+ *   YYYY-MM-DDTHH:MM:SS.mmm         exactly 3 fraction digits
+ * the last two optionally followed by 'Z' (never a bare date).
+ *
+ * The date part uses DateKey's rules (years 1900-2999), but days must
+ * exist in their month: an epoch is a real instant, so "2011-02-31"
+ * has no place in the order the way it does for DateKey.
+ */
+class Timestamp
+{
+private:
+    Timestamp();
+
+public:
+    static bool parse(const char* str, size_t len, int64_t& millis);
+
+    /**
+     * Days since 1970-01-01 of a proleptic Gregorian date
+     */
+    static int64_t daysFromCivil(int year, int month, int day);
+};
+
+#endif
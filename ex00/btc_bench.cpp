@@ -0,0 +1,948 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "InterleavedSearch.hpp"
+#include "BitcoinExchange.hpp"
+#include "DateKey.hpp"
+#include "Helpers.hpp"
+#include "PriceIndex.hpp"
+
+/**
+ * btc_bench: workload generator and benchmarks
+ *
+ * Usage: ./btc_bench search [rows ...]
+ *        ./btc_bench finger [rows]
+ *        ./btc_bench gen-db file [key=value ...]
+ *        ./btc_bench gen-input file [key=value ...]
+ *        ./btc_bench pipeline [key=value ...]
+ *        ./btc_bench dates
+ *        ./btc_bench ranges [rows]
+ *
+ * Settings (key=value, defaults in parentheses):
+ *   seed     generator seed (1); equal settings give equal files
+ *   rows     database rows (100000)
+ *   dups     fraction of database rows that repeat an earlier date
+ *            with a new rate (0)
+ *   order    database row order: sorted | random (sorted)
+ *   lines    input lines (1000000)
+ *   dist     input dates: sorted | reverse | random | hot, where hot
+ *            sends 90% of the lines to 64 dates (random)
+ *   errors   fraction of bad input lines, spread evenly over missing
+ *            '|', bad date, not a number, negative and too large (0.1)
+ *   runs     pipeline repetitions (5)
+ *   threads  -j of the measured BitcoinExchange (1)
+ *   dir      where pipeline writes its generated files (/tmp)
+ *
+ * gen-db / gen-input write one generated file, to feed ./btc directly.
+ *
+ * pipeline generates both files, then per run times separately, on a
+ * fresh BitcoinExchange:
+ *   load     loadDatabase (no snapshot)
+ *   lookup   resolveQueries over every valid input line, pre-parsed
+ *   process  processInputFile with stdout sent to /dev/null
+ * and prints one JSON object per run (with the --stats breakdown when
+ * built with it), then one with the min and median of each phase.
+ *
+ * search: closest-lower lookups of random (unsorted) keys in a sorted
+ * array of `rows` keys (default 1M 10M 100M), per query with
+ * std::upper_bound, per query with the branchless search PriceIndex
+ * uses (Helpers::lowerOrEqual), and with InterleavedSearch. The arrays
+ * are synthetic: DateKey days stop at ~409k rows, the point is the
+ * cache behaviour of big arrays. Prints ns per lookup; every method must give the same sum.
+ *
+ * finger: a PriceIndex of `rows` days (default 409000) queried in
+ * sorted, reverse sorted, random and clustered (runs of nearby dates)
+ * order, per query with findRate, with a PriceIndex::Cursor, with
+ * InterleavedSearch, with findRates (which picks one of the two per
+ * block, or the merge join) and with mergeRates. Same output format as
+ * search.
+ *
+ * dates: differential test of DateKey::parse against the original
+ * isValidDate (substr + atoi, below): acceptance and year / month /
+ * day / key must agree on
+ *   - all 10^8 digit strings DDDD-DD-DD
+ *   - every byte value at every position of 2000 random templates
+ *   - 16 x 16 chosen bytes at every pair of positions of a valid date
+ *   - 20M random strings of length 0-12
+ * then times both on valid dates. Exits 1 on any mismatch.
+ *
+ * ranges: a PriceIndex of `rows` days (default 409000) and 4M random
+ * "from .. to" ranges, half short and half of any length. Times the
+ * first findRange (which builds the RangeTable) and then findRange
+ * per range, and checks the first 20000 against a scan of their rows:
+ * same count, min and max, and the same sum up to rounding. Exits 1 on
+ * any mismatch.
+ */
+
+static const size_t SEARCH_QUERIES = 4000000;
+
+static const size_t RANGE_QUERIES = 4000000;
+static const size_t RANGE_CHECKS = 20000;
+
+static const size_t HOT_DATES = 64;
+
+struct Settings
+{
+    uint64_t seed;
+    size_t rows;
+    double dups;
+    std::string order;
+    size_t lines;
+    std::string dist;
+    double errors;
+    size_t runs;
+    size_t threads;
+    std::string dir;
+};
+
+static double nowSeconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void report(const char* method, size_t rows, double seconds, size_t queries, double sum)
+{
+    std::cout << std::setw(12) << rows << "  " << std::left << std::setw(12) << method
+              << std::right << std::fixed << std::setprecision(1) << std::setw(8)
+              << seconds * 1e9 / queries << " ns/lookup  (sum "
+              << std::setprecision(0) << sum << ")" << std::endl;
+}
+
+static void benchSearch(size_t rows)
+{
+    std::vector<uint32_t> keys(rows);
+    std::vector<float> values(rows);
+    unsigned int seed = 42;
+    uint32_t key = 1000;
+    for (size_t i = 0; i < rows; i++)
+    {
+        key += 1 + static_cast<uint32_t>(rand_r(&seed) % 40);
+        keys[i] = key;
+        values[i] = static_cast<float>(rand_r(&seed) % 1000);
+    }
+
+    std::vector<uint32_t> queries(SEARCH_QUERIES);
+    for (size_t i = 0; i < queries.size(); i++)
+        queries[i] = static_cast<uint32_t>((static_cast<uint64_t>(rand_r(&seed)) << 16
+                                            ^ static_cast<uint64_t>(rand_r(&seed))) % (key + 1000));
+
+    std::vector<float> rates(queries.size());
+    std::vector<unsigned char> found(queries.size());
+    double start;
+    double sum;
+
+    start = nowSeconds();
+    sum = 0;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        const uint32_t* row = std::upper_bound(&keys[0], &keys[0] + rows, queries[i]);
+        if (row != &keys[0])
+            sum += values[row - 1 - &keys[0]];
+    }
+    report("upper_bound", rows, nowSeconds() - start, queries.size(), sum);
+
+    start = nowSeconds();
+    sum = 0;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        size_t row = Helpers::lowerOrEqual(&keys[0], rows, queries[i]);
+        if (keys[row] <= queries[i])
+            sum += values[row];
+    }
+    report("branchless", rows, nowSeconds() - start, queries.size(), sum);
+
+    start = nowSeconds();
+    InterleavedSearch::findRates(&keys[0], &values[0], rows, &queries[0], queries.size(),
+                                 &rates[0], &found[0]);
+    sum = 0;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        if (found[i])
+            sum += rates[i];
+    }
+    report("interleaved", rows, nowSeconds() - start, queries.size(), sum);
+}
+
+static void benchFinger(size_t rows)
+{
+    rows = std::min<size_t>(std::max<size_t>(rows, 1), DateKey::KEY_SPACE);
+    std::vector<PriceIndex::Entry> entries(rows);
+    unsigned int seed = 42;
+    for (size_t i = 0; i < rows; i++)
+    {
+        entries[i].key = static_cast<uint32_t>(DateKey::KEY_SPACE - rows + i);
+        entries[i].rate = static_cast<float>(rand_r(&seed) % 1000);
+    }
+    PriceIndex index;
+    index.build(entries);
+
+    const char* orders[] = { "sorted", "reverse", "random", "clustered" };
+    std::vector<uint32_t> queries(SEARCH_QUERIES);
+    std::vector<float> rates(queries.size());
+    std::vector<unsigned char> found(queries.size());
+
+    for (size_t o = 0; o < 4; o++)
+    {
+        uint32_t first = index.keys()[0];
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            if (o == 3 && i % 16 != 0)
+                queries[i] = queries[i - 1] + static_cast<uint32_t>(rand_r(&seed) % 9) - 4;
+            else
+                queries[i] = first - 10 + static_cast<uint32_t>(rand_r(&seed) % (rows + 20));
+            queries[i] = std::min(queries[i], DateKey::KEY_SPACE + 9);
+        }
+        if (o < 2)
+            std::sort(queries.begin(), queries.end());
+        if (o == 1)
+            std::reverse(queries.begin(), queries.end());
+
+        std::cout << orders[o] << std::endl;
+        double start = nowSeconds();
+        double sum = 0;
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            float rate;
+            if (index.findRate(queries[i], rate))
+                sum += rate;
+        }
+        report("findRate", rows, nowSeconds() - start, queries.size(), sum);
+
+        start = nowSeconds();
+        sum = 0;
+        PriceIndex::Cursor cursor(index);
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            float rate;
+            if (cursor.findRate(queries[i], rate))
+                sum += rate;
+        }
+        report("cursor", rows, nowSeconds() - start, queries.size(), sum);
+
+        start = nowSeconds();
+        InterleavedSearch::findRates(index.keys(), index.rates(), index.size(),
+                                     &queries[0], queries.size(), &rates[0], &found[0]);
+        sum = 0;
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            if (found[i])
+                sum += rates[i];
+        }
+        report("interleaved", rows, nowSeconds() - start, queries.size(), sum);
+
+        start = nowSeconds();
+        index.findRates(&queries[0], queries.size(), &rates[0], &found[0]);
+        sum = 0;
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            if (found[i])
+                sum += rates[i];
+        }
+        report("findRates", rows, nowSeconds() - start, queries.size(), sum);
+
+        start = nowSeconds();
+        index.mergeRates(&queries[0], queries.size(), &rates[0], &found[0]);
+        sum = 0;
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            if (found[i])
+                sum += rates[i];
+        }
+        report("merge", rows, nowSeconds() - start, queries.size(), sum);
+    }
+}
+
+/**
+ * splitmix64: small, seedable and the same on every platform
+ */
+static uint64_t nextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static size_t randomBelow(uint64_t& state, size_t n)
+{
+    return static_cast<size_t>(nextRandom(state) % n);
+}
+
+static double randomUnit(uint64_t& state)
+{
+    return static_cast<double>(nextRandom(state) >> 11) / 9007199254740992.0;
+}
+
+static void appendNumber(std::string& out, unsigned long value, int width)
+{
+    char digits[24];
+    int n = 0;
+    do
+    {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0 || n < width);
+    while (n > 0)
+        out += digits[--n];
+}
+
+/**
+ * YYYY-MM-DD of a DateKey day number (every key is a valid date)
+ */
+static void appendDate(std::string& out, uint32_t key)
+{
+    appendNumber(out, DateKey::MIN_YEAR + key / (DateKey::MONTHS_PER_YEAR * DateKey::DAYS_PER_MONTH), 4);
+    out += '-';
+    appendNumber(out, key / DateKey::DAYS_PER_MONTH % DateKey::MONTHS_PER_YEAR + 1, 2);
+    out += '-';
+    appendNumber(out, key % DateKey::DAYS_PER_MONTH + 1, 2);
+}
+
+/**
+ * Value with two decimals, from hundredths
+ */
+static void appendValue(std::string& out, long hundredths)
+{
+    if (hundredths < 0)
+    {
+        out += '-';
+        hundredths = -hundredths;
+    }
+    appendNumber(out, static_cast<unsigned long>(hundredths / 100), 1);
+    out += '.';
+    appendNumber(out, static_cast<unsigned long>(hundredths % 100), 2);
+}
+
+/**
+ * First key of the database: 2009-01-01, or earlier when the rows
+ * would not fit before 2999-12-31
+ */
+static uint32_t firstKey(const Settings& settings)
+{
+    size_t unique = settings.rows - static_cast<size_t>(settings.rows * settings.dups);
+    uint32_t start = DateKey::fromYMD(2009, 1, 1);
+    if (unique > DateKey::KEY_SPACE - start)
+        start = (unique >= DateKey::KEY_SPACE) ? 0 : static_cast<uint32_t>(DateKey::KEY_SPACE - unique);
+    return start;
+}
+
+static size_t uniqueDays(const Settings& settings)
+{
+    size_t unique = settings.rows - static_cast<size_t>(settings.rows * settings.dups);
+    return std::max<size_t>(1, std::min<size_t>(unique, DateKey::KEY_SPACE - firstKey(settings)));
+}
+
+static bool writeFile(const std::string& path, const std::string& text)
+{
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    return file.good();
+}
+
+/**
+ * date,exchange_rate CSV: one row per day from firstKey, plus
+ * rows * dups rows repeating a random earlier day
+ */
+static bool generateDatabase(const std::string& path, const Settings& settings)
+{
+    uint64_t state = settings.seed * 2 + 1;
+    uint32_t start = firstKey(settings);
+    size_t unique = uniqueDays(settings);
+    std::vector<std::pair<uint32_t, long> > rows;
+
+    rows.reserve(settings.rows);
+    for (size_t i = 0; i < unique; i++)
+        rows.push_back(std::make_pair(start + static_cast<uint32_t>(i),
+                                      static_cast<long>(randomBelow(state, 10000000))));
+    while (rows.size() < settings.rows)
+        rows.push_back(std::make_pair(start + static_cast<uint32_t>(randomBelow(state, unique)),
+                                      static_cast<long>(randomBelow(state, 10000000))));
+
+    if (settings.order == "random")
+    {
+        for (size_t i = rows.size(); i > 1; i--)
+            std::swap(rows[i - 1], rows[randomBelow(state, i)]);
+    }
+    else
+        std::stable_sort(rows.begin(), rows.end());
+
+    std::string text = "date,exchange_rate\n";
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        appendDate(text, rows[i].first);
+        text += ',';
+        appendValue(text, rows[i].second);
+        text += '\n';
+    }
+    return writeFile(path, text);
+}
+
+/**
+ * Input lines over the database's days, with 1% of the dates before
+ * the first row ("no exchange rate"), and settings.errors bad lines
+ */
+static bool generateInput(const std::string& path, const Settings& settings)
+{
+    uint64_t state = settings.seed * 2 + 2;
+    uint32_t start = firstKey(settings);
+    size_t span = uniqueDays(settings);
+    uint32_t early = std::min<uint32_t>(start, static_cast<uint32_t>(span / 100 + 1));
+    std::vector<uint32_t> hot(HOT_DATES);
+    std::vector<uint32_t> keys(settings.lines);
+
+    for (size_t i = 0; i < hot.size(); i++)
+        hot[i] = start + static_cast<uint32_t>(randomBelow(state, span));
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (settings.dist == "hot" && randomUnit(state) < 0.9)
+            keys[i] = hot[randomBelow(state, hot.size())];
+        else
+            keys[i] = start - early + static_cast<uint32_t>(randomBelow(state, span + early));
+    }
+    if (settings.dist == "sorted" || settings.dist == "reverse")
+        std::sort(keys.begin(), keys.end());
+    if (settings.dist == "reverse")
+        std::reverse(keys.begin(), keys.end());
+
+    std::string text = "date | value\n";
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        std::string date;
+        appendDate(date, keys[i]);
+        if (randomUnit(state) >= settings.errors)
+        {
+            text += date + " | ";
+            appendValue(text, static_cast<long>(randomBelow(state, 100001)));
+        }
+        else
+        {
+            switch (randomBelow(state, 5))
+            {
+                case 0:
+                    text += date + " ";
+                    appendValue(text, 100);
+                    break;
+                case 1:
+                    text += date.substr(0, 5) + "13-45 | 1";
+                    break;
+                case 2:
+                    text += date + " | abc";
+                    break;
+                case 3:
+                    text += date + " | ";
+                    appendValue(text, -static_cast<long>(1 + randomBelow(state, 100000)));
+                    break;
+                default:
+                    text += date + " | ";
+                    appendValue(text, static_cast<long>(100001 + randomBelow(state, 100000)));
+                    break;
+            }
+        }
+        text += '\n';
+    }
+    return writeFile(path, text);
+}
+
+/**
+ * Valid "date | value" lines of a generated input, as queries
+ */
+static void readQueries(const std::string& path, std::vector<BitcoinExchange::Query>& queries)
+{
+    std::ifstream file(path.c_str());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        BitcoinExchange::Query query;
+        if (line.size() < 14 || line.compare(10, 3, " | ") != 0
+            || !DateKey::parse(line.c_str(), 10, query.key))
+            continue;
+        char* end;
+        query.value = std::strtof(line.c_str() + 13, &end);
+        if (*end == '\0' && query.value >= 0 && query.value <= 1000)
+            queries.push_back(query);
+    }
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return (n % 2) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+static bool benchPipeline(const Settings& settings)
+{
+    std::string db = settings.dir + "/btc_bench_db.csv";
+    std::string input = settings.dir + "/btc_bench_input.txt";
+    if (!generateDatabase(db, settings) || !generateInput(input, settings))
+    {
+        std::cerr << "Error: could not write to " << settings.dir << std::endl;
+        return false;
+    }
+
+    std::vector<BitcoinExchange::Query> queries;
+    readQueries(input, queries);
+
+    std::ostringstream setup;
+    setup << "\"rows\":" << settings.rows << ",\"dups\":" << settings.dups
+          << ",\"order\":\"" << settings.order << "\",\"lines\":" << settings.lines
+          << ",\"dist\":\"" << settings.dist << "\",\"errors\":" << settings.errors
+          << ",\"seed\":" << settings.seed << ",\"threads\":" << settings.threads;
+
+    std::vector<double> phases[3];
+    const char* names[3] = { "load_ms", "lookup_ms", "process_ms" };
+    int saved = dup(1);
+    int null = open("/dev/null", O_WRONLY);
+
+    for (size_t run = 0; run < settings.runs; run++)
+    {
+        BitcoinExchange btc;
+        btc.setSnapshotEnabled(false);
+        btc.setThreadCount(settings.threads);
+
+        double start = nowSeconds();
+        btc.loadDatabase(db);
+        phases[0].push_back((nowSeconds() - start) * 1e3);
+
+        start = nowSeconds();
+        btc.resolveQueries(queries);
+        phases[1].push_back((nowSeconds() - start) * 1e3);
+
+        std::cout.flush();
+        dup2(null, 1);
+        start = nowSeconds();
+        btc.processInputFile(input);
+        phases[2].push_back((nowSeconds() - start) * 1e3);
+        std::cout.flush();
+        dup2(saved, 1);
+
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(3) << "{\"run\":" << run << ',' << setup.str();
+        for (size_t p = 0; p < 3; p++)
+            line << ",\"" << names[p] << "\":" << phases[p].back();
+#ifdef BTC_STATS
+        std::ostringstream stats;
+        btc.printStats(stats, true);
+        std::string text = stats.str();
+        line << ",\"stats\":" << text.substr(0, text.find('\n'));
+#endif
+        line << "}\n";
+        std::cout.write(line.str().data(), static_cast<std::streamsize>(line.str().size()));
+    }
+    close(null);
+    close(saved);
+
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(3) << "{\"summary\":true," << setup.str()
+            << ",\"runs\":" << settings.runs << ",\"queries\":" << queries.size();
+    for (size_t p = 0; p < 3 && settings.runs > 0; p++)
+        summary << ",\"" << names[p] << "\":{\"min\":"
+                << *std::min_element(phases[p].begin(), phases[p].end())
+                << ",\"median\":" << median(phases[p]) << '}';
+    summary << "}\n";
+    std::cout.write(summary.str().data(), static_cast<std::streamsize>(summary.str().size()));
+    std::cout.flush();
+    return true;
+}
+
+/**
+ * key=value arguments into settings; false on an unknown key
+ */
+static bool parseSettings(int argc, char** argv, int first, Settings& settings)
+{
+    settings.seed = 1;
+    settings.rows = 100000;
+    settings.dups = 0;
+    settings.order = "sorted";
+    settings.lines = 1000000;
+    settings.dist = "random";
+    settings.errors = 0.1;
+    settings.runs = 5;
+    settings.threads = 1;
+    settings.dir = "/tmp";
+
+    for (int i = first; i < argc; i++)
+    {
+        const char* eq = std::strchr(argv[i], '=');
+        if (!eq)
+            return false;
+        std::string key(argv[i], static_cast<size_t>(eq - argv[i]));
+        const char* value = eq + 1;
+
+        if (key == "seed")
+            settings.seed = std::strtoull(value, NULL, 10);
+        else if (key == "rows")
+            settings.rows = std::strtoul(value, NULL, 10);
+        else if (key == "dups")
+            settings.dups = std::min(1.0, std::max(0.0, std::strtod(value, NULL)));
+        else if (key == "order")
+            settings.order = value;
+        else if (key == "lines")
+            settings.lines = std::strtoul(value, NULL, 10);
+        else if (key == "dist")
+            settings.dist = value;
+        else if (key == "errors")
+            settings.errors = std::min(1.0, std::max(0.0, std::strtod(value, NULL)));
+        else if (key == "runs")
+            settings.runs = std::strtoul(value, NULL, 10);
+        else if (key == "threads")
+            settings.threads = std::max(1ul, std::strtoul(value, NULL, 10));
+        else if (key == "dir")
+            settings.dir = value;
+        else
+            return false;
+    }
+    return settings.rows > 0;
+}
+
+/**
+ * BitcoinExchange::isValidDate as it was before DateKey
+ */
+static bool referenceIsValidDate(const std::string& date, int& year, int& month, int& day)
+{
+    if (date.length() != 10)
+        return false;
+    if (date[4] != '-' || date[7] != '-')
+        return false;
+    for (int i = 0; i < 10; i++)
+    {
+        if (i == 4 || i == 7)
+            continue;
+        if (!std::isdigit(static_cast<unsigned char>(date[i])))
+            return false;
+    }
+    year = std::atoi(date.substr(0, 4).c_str());
+    month = std::atoi(date.substr(5, 2).c_str());
+    day = std::atoi(date.substr(8, 2).c_str());
+    if (year < 1900 || year > 2999)
+        return false;
+    if (month < 1 || month > 12)
+        return false;
+    if (day < 1 || day > 31)
+        return false;
+    return true;
+}
+
+/**
+ * One case of benchDates; prints the first few mismatches
+ */
+static bool sameDate(const std::string& date, size_t& mismatches)
+{
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    DateKey::Fields fields;
+    bool expected = referenceIsValidDate(date, year, month, day);
+    bool got = DateKey::parse(date.data(), date.length(), fields);
+
+    if (got == expected && (!got || (fields.year == year && fields.month == month
+                                     && fields.day == day
+                                     && fields.key == DateKey::fromYMD(year, month, day))))
+        return true;
+    if (mismatches++ < 10)
+    {
+        std::cout << "mismatch:";
+        for (size_t i = 0; i < date.length(); i++)
+            std::cout << ' ' << static_cast<int>(static_cast<unsigned char>(date[i]));
+        std::cout << "  reference " << expected << ", DateKey " << got << std::endl;
+    }
+    return false;
+}
+
+static std::string randomDate(uint64_t& state)
+{
+    std::string date(10, '-');
+    for (size_t i = 0; i < 10; i++)
+    {
+        if (i != 4 && i != 7)
+            date[i] = static_cast<char>('0' + randomBelow(state, 10));
+    }
+    return date;
+}
+
+static bool benchDates()
+{
+    static const char SPECIAL[16] = {
+        '0', '1', '2', '3', '9', '-', '/', ' ', ':', '+', 'a', '\0',
+        static_cast<char>(0x80), static_cast<char>(0xff), '0' - 1, '9' + 1
+    };
+    uint64_t state = 1;
+    size_t cases = 0;
+    size_t mismatches = 0;
+    std::string date = "0000-00-00";
+
+    // All digit strings
+    for (uint32_t n = 0; n < 100000000; n++)
+    {
+        uint32_t v = n;
+        for (int i = 9; i >= 0; i--)
+        {
+            if (i == 4 || i == 7)
+                continue;
+            date[i] = static_cast<char>('0' + v % 10);
+            v /= 10;
+        }
+        sameDate(date, mismatches);
+    }
+    cases += 100000000;
+
+    // Every byte at every position of random templates
+    for (size_t t = 0; t < 2000; t++)
+    {
+        std::string base = randomDate(state);
+        for (size_t i = 0; i < 10; i++)
+        {
+            for (int c = 0; c < 256; c++)
+            {
+                date = base;
+                date[i] = static_cast<char>(c);
+                sameDate(date, mismatches);
+            }
+        }
+        cases += 10 * 256;
+    }
+
+    // Chosen byte pairs at every pair of positions
+    std::string valid = "2011-02-31";
+    for (size_t i = 0; i < 10; i++)
+    {
+        for (size_t j = i + 1; j < 10; j++)
+        {
+            for (size_t a = 0; a < 16; a++)
+            {
+                for (size_t b = 0; b < 16; b++)
+                {
+                    date = valid;
+                    date[i] = SPECIAL[a];
+                    date[j] = SPECIAL[b];
+                    sameDate(date, mismatches);
+                    cases++;
+                }
+            }
+        }
+    }
+
+    // Random strings, mostly date-like
+    for (size_t n = 0; n < 20000000; n++)
+    {
+        size_t len = randomBelow(state, 13);
+        date.resize(len);
+        for (size_t i = 0; i < len; i++)
+        {
+            size_t r = randomBelow(state, 4);
+            date[i] = (r == 0) ? static_cast<char>(randomBelow(state, 256))
+                    : (r == 1) ? '-' : static_cast<char>('0' + randomBelow(state, 10));
+        }
+        sameDate(date, mismatches);
+    }
+    cases += 20000000;
+
+    std::cout << cases << " strings, " << mismatches << " mismatches" << std::endl;
+
+    // Throughput on valid dates
+    std::vector<std::string> dates(1000000);
+    for (size_t i = 0; i < dates.size(); i++)
+    {
+        uint32_t key = static_cast<uint32_t>(randomBelow(state, DateKey::KEY_SPACE));
+        char text[16];
+        std::sprintf(text, "%04u-%02u-%02u", 1900 + key / 372, key / 31 % 12 + 1, key % 31 + 1);
+        dates[i] = text;
+    }
+    for (int method = 0; method < 2; method++)
+    {
+        uint64_t sum = 0;
+        double start = nowSeconds();
+        for (int run = 0; run < 10; run++)
+        {
+            for (size_t i = 0; i < dates.size(); i++)
+            {
+                int year = 0;
+                int month = 0;
+                int day = 0;
+                DateKey::Fields fields;
+                if (method == 0)
+                    sum += referenceIsValidDate(dates[i], year, month, day) ? day : 0;
+                else
+                    sum += DateKey::parse(dates[i].data(), dates[i].length(), fields) ? fields.day : 0;
+            }
+        }
+        double seconds = nowSeconds() - start;
+        std::cout << std::left << std::setw(18) << (method ? "DateKey::parse" : "isValidDate (orig)")
+                  << std::right << std::fixed << std::setprecision(1) << std::setw(8)
+                  << dates.size() * 10 / seconds / 1e6 << " M dates/s  (sum " << sum << ")" << std::endl;
+    }
+    return mismatches == 0;
+}
+
+/**
+ * One random "from .. to" pair around the keys of benchRanges: half
+ * short (up to SHORT_RANGE days), half of any length, a few starting
+ * before the first row or ending after the last
+ */
+static void randomRange(uint64_t& state, uint32_t first, size_t rows,
+                        uint32_t& from, uint32_t& to)
+{
+    static const size_t SHORT_RANGE = 64;
+    from = first - 10 + static_cast<uint32_t>(randomBelow(state, rows + 20));
+    size_t length = randomBelow(state, 2) ? randomBelow(state, SHORT_RANGE)
+                                          : randomBelow(state, rows + 20);
+    to = from + static_cast<uint32_t>(length);
+}
+
+static bool benchRanges(size_t rows)
+{
+    rows = std::min<size_t>(std::max<size_t>(rows, 1), DateKey::KEY_SPACE);
+    std::vector<PriceIndex::Entry> entries(rows);
+    uint64_t state = 42;
+    double total = 0;
+    for (size_t i = 0; i < rows; i++)
+    {
+        entries[i].key = static_cast<uint32_t>(DateKey::KEY_SPACE - rows + i);
+        entries[i].rate = static_cast<float>(randomBelow(state, 100000)) / 100;
+        total += entries[i].rate;
+    }
+    PriceIndex index;
+    index.build(entries);
+    const uint32_t* keys = index.keys();
+    const float* rates = index.rates();
+    uint32_t first = keys[0];
+    RangeTable::Stats stats;
+
+    double start = nowSeconds();
+    index.findRange(first, first, stats);
+    std::cout << "first findRange (builds the table): " << std::fixed << std::setprecision(2)
+              << (nowSeconds() - start) * 1e3 << " ms, index "
+              << index.memoryUsage() / 1024 << " KiB" << std::endl;
+
+    std::vector<uint32_t> from(RANGE_QUERIES);
+    std::vector<uint32_t> to(RANGE_QUERIES);
+    for (size_t i = 0; i < from.size(); i++)
+        randomRange(state, first, rows, from[i], to[i]);
+
+    start = nowSeconds();
+    double sum = 0;
+    for (size_t i = 0; i < from.size(); i++)
+    {
+        if (index.findRange(from[i], to[i], stats))
+            sum += stats.sum + stats.min + stats.max;
+    }
+    report("findRange", rows, nowSeconds() - start, from.size(), sum);
+
+    // Same answers by scanning the rows, on the first RANGE_CHECKS ranges
+    size_t mismatches = 0;
+    start = nowSeconds();
+    sum = 0;
+    for (size_t i = 0; i < RANGE_CHECKS; i++)
+    {
+        const uint32_t* end = keys + rows;
+        size_t last = static_cast<size_t>(std::upper_bound(keys, end, to[i]) - keys);
+        size_t lo = (from[i] < first) ? 0
+                  : static_cast<size_t>(std::upper_bound(keys, end, from[i]) - keys) - 1;
+        bool expected = last > 0;
+        RangeTable::Stats scan = { 0, 0, 0, 0 };
+        if (expected)
+        {
+            scan.min = rates[lo];
+            scan.max = rates[lo];
+            for (size_t row = lo; row < last; row++)
+            {
+                scan.count++;
+                scan.min = std::min(scan.min, rates[row]);
+                scan.max = std::max(scan.max, rates[row]);
+                scan.sum += rates[row];
+            }
+            sum += scan.sum + scan.min + scan.max;
+        }
+
+        bool got = index.findRange(from[i], to[i], stats);
+        if (got == expected && (!got || (stats.count == scan.count && stats.min == scan.min
+                                          && stats.max == scan.max
+                                          && std::fabs(stats.sum - scan.sum) <= total * 1e-12)))
+            continue;
+        if (mismatches++ < 10)
+            std::cout << "mismatch: " << from[i] << " .. " << to[i] << std::endl;
+    }
+    report("scan", rows, nowSeconds() - start, RANGE_CHECKS, sum);
+    std::cout << RANGE_CHECKS << " ranges checked against a scan, "
+              << mismatches << " mismatches" << std::endl;
+    return mismatches == 0;
+}
+
+static int usage(const char* name)
+{
+    std::cerr << "Usage: " << name << " search [rows ...]\n"
+              << "       " << name << " finger [rows]\n"
+              << "       " << name << " gen-db file [key=value ...]\n"
+              << "       " << name << " gen-input file [key=value ...]\n"
+              << "       " << name << " pipeline [key=value ...]\n"
+              << "       " << name << " dates\n"
+              << "       " << name << " ranges [rows]" << std::endl;
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+
+    if (argc >= 3 && std::strcmp(argv[1], "gen-db") == 0)
+    {
+        if (!parseSettings(argc, argv, 3, settings))
+            return usage(argv[0]);
+        return generateDatabase(argv[2], settings) ? 0 : 1;
+    }
+    if (argc >= 3 && std::strcmp(argv[1], "gen-input") == 0)
+    {
+        if (!parseSettings(argc, argv, 3, settings))
+            return usage(argv[0]);
+        return generateInput(argv[2], settings) ? 0 : 1;
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "finger") == 0)
+    {
+        benchFinger(argc >= 3 ? std::strtoul(argv[2], NULL, 10) : 409000);
+        return 0;
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "pipeline") == 0)
+    {
+        if (!parseSettings(argc, argv, 2, settings))
+            return usage(argv[0]);
+        return benchPipeline(settings) ? 0 : 1;
+    }
+    if (argc == 2 && std::strcmp(argv[1], "dates") == 0)
+        return benchDates() ? 0 : 1;
+    if (argc >= 2 && std::strcmp(argv[1], "ranges") == 0)
+        return benchRanges(argc >= 3 ? std::strtoul(argv[2], NULL, 10) : 409000) ? 0 : 1;
+    if (argc < 2 || std::strcmp(argv[1], "search") != 0)
+        return usage(argv[0]);
+
+    std::vector<size_t> sizes;
+    for (int i = 2; i < argc; i++)
+        sizes.push_back(static_cast<size_t>(std::strtoul(argv[i], NULL, 10)));
+    if (sizes.empty())
+    {
+        sizes.push_back(1000000);
+        sizes.push_back(10000000);
+        sizes.push_back(100000000);
+    }
+
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        if (sizes[i] > 0)
+            benchSearch(sizes[i]);
+    }
+    return 0;
+}
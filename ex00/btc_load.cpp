@@ -0,0 +1,164 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+/**
+ * btc_load: load generator for `./btc serve`
+ * 
+ * Usage: ./btc_load socket_path [clients] [requests_per_client] [window]
+ * 
+ * Each client thread opens one connection and keeps up to `window`
+ * requests in flight (pipelining). Every request is a well-formed
+ * "date | value" line, so it gets exactly one response line; the
+ * latency of a request is the time from writing its line to reading
+ * its response line.
+ * 
+ * Prints throughput and p50 / p99 / max latency over all requests.
+ */
+
+struct ClientJob
+{
+    const char* path;
+    size_t requests;
+    size_t window;
+    unsigned int seed;
+    std::vector<double> latencies;
+    bool failed;
+};
+
+static double nowMicros()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static std::string makeRequest(unsigned int& seed)
+{
+    std::ostringstream line;
+    int year = 2009 + static_cast<int>(rand_r(&seed) % 14);
+    int month = 1 + static_cast<int>(rand_r(&seed) % 12);
+    int day = 1 + static_cast<int>(rand_r(&seed) % 31);
+    line << year << '-' << std::setw(2) << std::setfill('0') << month
+         << '-' << std::setw(2) << day << " | " << (rand_r(&seed) % 1000) << '\n';
+    return line.str();
+}
+
+static void* runClient(void* arg)
+{
+    ClientJob* job = static_cast<ClientJob*>(arg);
+    job->failed = true;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, job->path, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+
+    std::vector<double> sent_at(job->requests);
+    size_t sent = 0;
+    size_t answered = 0;
+    char buf[1 << 16];
+    job->latencies.reserve(job->requests);
+
+    while (answered < job->requests)
+    {
+        // Fill the window with one write
+        std::string batch;
+        double now = nowMicros();
+        while (sent < job->requests && sent - answered < job->window)
+        {
+            batch += makeRequest(job->seed);
+            sent_at[sent++] = now;
+        }
+        if (!batch.empty() && send(fd, batch.data(), batch.size(), MSG_NOSIGNAL)
+                              != static_cast<ssize_t>(batch.size()))
+            break;
+
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            break;
+        now = nowMicros();
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (buf[i] == '\n' && answered < sent)
+            {
+                job->latencies.push_back(now - sent_at[answered]);
+                answered++;
+            }
+        }
+    }
+    close(fd);
+    job->failed = (answered != job->requests);
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: ./btc_load socket_path [clients] [requests] [window]" << std::endl;
+        return 1;
+    }
+    size_t clients = (argc > 2) ? static_cast<size_t>(std::atoi(argv[2])) : 8;
+    size_t requests = (argc > 3) ? static_cast<size_t>(std::atoi(argv[3])) : 100000;
+    size_t window = (argc > 4) ? static_cast<size_t>(std::atoi(argv[4])) : 64;
+    if (clients < 1 || requests < 1 || window < 1)
+    {
+        std::cerr << "Error: invalid argument." << std::endl;
+        return 1;
+    }
+
+    std::vector<ClientJob> jobs(clients);
+    std::vector<pthread_t> tids(clients);
+    double start = nowMicros();
+    for (size_t i = 0; i < clients; i++)
+    {
+        jobs[i].path = argv[1];
+        jobs[i].requests = requests;
+        jobs[i].window = window;
+        jobs[i].seed = static_cast<unsigned int>(i + 1);
+        pthread_create(&tids[i], NULL, runClient, &jobs[i]);
+    }
+    for (size_t i = 0; i < clients; i++)
+        pthread_join(tids[i], NULL);
+    double elapsed = (nowMicros() - start) / 1e6;
+
+    std::vector<double> all;
+    for (size_t i = 0; i < clients; i++)
+    {
+        if (jobs[i].failed)
+        {
+            std::cerr << "Error: client " << i << " failed." << std::endl;
+            return 1;
+        }
+        all.insert(all.end(), jobs[i].latencies.begin(), jobs[i].latencies.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "clients " << clients << ", window " << window
+              << ", requests " << all.size() << std::endl;
+    std::cout << "throughput " << all.size() / elapsed << " req/s" << std::endl;
+    std::cout << "latency us: p50 " << all[all.size() / 2]
+              << "  p99 " << all[all.size() * 99 / 100]
+              << "  max " << all.back() << std::endl;
+    return 0;
+}
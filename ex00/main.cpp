@@ -1,39 +1,194 @@
 #include "BitcoinExchange.hpp"
+#include "BtcServer.hpp"
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 
 /**
  * Bitcoin Exchange Program
  * 
- * Usage: ./btc [input_file]
+ * Usage: ./btc [options] input_file
+ *        ./btc [options] --rebuild-snapshot
+ *        ./btc [options] serve socket_path
  * 
  * The program:
- * 1. Loads Bitcoin price database (data.csv)
+ * 1. Loads Bitcoin price database (data.csv, or its data.csv.snap)
  * 2. Reads transactions from input file
  * 3. Calculates Bitcoin values for each date
  * 4. Uses closest lower date if exact date not in database
+ * 
+ * Options:
+ *   -j threads      load data.csv and process the input on this many
+ *                   threads (default 1); output order is unchanged
+ *   --no-snapshot   always parse data.csv, never read/write data.csv.snap
+ *   --dense         O(1) lookups through a calendar table (if not too sparse)
+ *   --assets spec   also load other assets, priced by "date | value | NAME"
+ *                   lines: NAME=file.csv (date,rate) or a wide CSV
+ *                   (date,NAME1,NAME2,...); repeatable
+ *   --ticks file    answer ISO-8601 timestamped lines from a
+ *                   timestamp,rate tick CSV instead of data.csv
+ *                   (not with --assets)
+ *   --compact       with --ticks: delta-encoded timestamp blocks
+ *   --stats[=json]  print line counts by outcome and per-stage times to
+ *                   stderr at exit (not in builds made with STATS=0)
+ * 
+ *   --rebuild-snapshot
+ *                   rebuild data.csv.snap from data.csv and exit (no
+ *                   input file)
+ * 
+ * Subcommands:
+ *   serve path      load once, then answer "date | value" lines from
+ *                   clients of the Unix socket at path (see BtcServer)
  */
 int main(int argc, char** argv)
 {
+    size_t threads = 1;
+    bool use_snapshot = true;
+    bool dense = false;
+    std::vector<std::string> assets;
+    const char* ticks = NULL;
+    bool compact = false;
+    bool stats = false;
+    bool stats_json = false;
+    bool rebuild_snapshot = false;
+    int arg = 1;
+    
+    // Parse options (the last argument is the input file, unless it is
+    // --rebuild-snapshot)
+    while (arg < argc && argv[arg][0] == '-'
+           && (arg < argc - 1 || std::strcmp(argv[arg], "--rebuild-snapshot") == 0))
+    {
+        // An option and its value with nothing after them: no input file
+        bool has_value = (std::strcmp(argv[arg], "-j") == 0
+                          || std::strcmp(argv[arg], "--assets") == 0
+                          || std::strcmp(argv[arg], "--ticks") == 0);
+        if (has_value && arg + 1 == argc - 1)
+        {
+            std::cerr << "Error: could not open file." << std::endl;
+            return 1;
+        }
+        
+        if (std::strcmp(argv[arg], "-j") == 0)
+        {
+            int n = std::atoi(argv[arg + 1]);
+            if (n < 1)
+            {
+                std::cerr << "Error: invalid thread count." << std::endl;
+                return 1;
+            }
+            threads = static_cast<size_t>(n);
+            arg += 2;
+        }
+        else if (std::strcmp(argv[arg], "--no-snapshot") == 0)
+        {
+            use_snapshot = false;
+            arg++;
+        }
+        else if (std::strcmp(argv[arg], "--dense") == 0)
+        {
+            dense = true;
+            arg++;
+        }
+        else if (std::strcmp(argv[arg], "--assets") == 0)
+        {
+            assets.push_back(argv[arg + 1]);
+            arg += 2;
+        }
+        else if (std::strcmp(argv[arg], "--ticks") == 0)
+        {
+            ticks = argv[arg + 1];
+            arg += 2;
+        }
+        else if (std::strcmp(argv[arg], "--rebuild-snapshot") == 0)
+        {
+            rebuild_snapshot = true;
+            arg++;
+        }
+        else if (std::strcmp(argv[arg], "--compact") == 0)
+        {
+            compact = true;
+            arg++;
+        }
+        else if (std::strcmp(argv[arg], "--stats") == 0
+                 || std::strcmp(argv[arg], "--stats=json") == 0)
+        {
+#ifndef BTC_STATS
+            std::cerr << "Error: built without stats (make STATS=1)." << std::endl;
+            return 1;
+#endif
+            stats = true;
+            stats_json = (argv[arg][7] == '=');
+            arg++;
+        }
+        else
+        {
+            std::cerr << "Error: unknown option " << argv[arg] << std::endl;
+            return 1;
+        }
+    }
+    
     // Check argument count
-    if (argc != 2)
+    bool serve = (argc - arg == 2 && std::strcmp(argv[arg], "serve") == 0);
+    if (rebuild_snapshot ? argc != arg : (argc - arg != 1 && !serve))
     {
         std::cerr << "Error: could not open file." << std::endl;
         return 1;
     }
     
+    // Tick lines are priced in BTC only
+    if (ticks && !assets.empty())
+    {
+        std::cerr << "Error: --ticks cannot be combined with --assets." << std::endl;
+        return 1;
+    }
+    
     // Create exchange object
     BitcoinExchange btc;
+    btc.setThreadCount(threads);
+    btc.setSnapshotEnabled(use_snapshot);
+    btc.setDenseLookup(dense);
+    
+    if (rebuild_snapshot)
+    {
+        if (!btc.rebuildSnapshot("data.csv"))
+            return 1;
+        std::cout << "Snapshot written: " << btc.size() << " rows." << std::endl;
+        return 0;
+    }
     
     // Load the Bitcoin price database
     // This file should be in the same directory as the binary
-    if (!btc.loadDatabase("data.csv"))
+    // (or, with --ticks, the tick file in its place)
+    if (ticks)
+    {
+        if (!btc.loadTicks(ticks, compact))
+            return 1;
+    }
+    else if (!btc.loadDatabase("data.csv"))
     {
         std::cerr << "Error: could not open file." << std::endl;
         return 1;
     }
     
+    if (!assets.empty() && !btc.loadAssets(assets))
+        return 1;
+    
+    if (serve)
+    {
+        BtcServer server(btc);
+        if (!server.run(argv[arg + 1]))
+        {
+            std::cerr << "Error: could not listen on " << argv[arg + 1] << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    
     // Process the input file
-    btc.processInputFile(argv[1]);
+    btc.processInputFile(argv[arg]);
     
+    if (stats)
+        btc.printStats(std::cerr, stats_json);
     return 0;
-}
\ No newline at end of file
+}
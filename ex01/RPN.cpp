@@ -1,131 +1,152 @@
 #include "RPN.hpp"
+#include <climits>
 
-RPN::RPN()
-{
-}
-
-RPN::RPN(const RPN& other)
+/**
+ * Character classes of the tokenizer
+ * 
+ * Spaces are those of operator>> (isspace in the "C" locale); '+' and
+ * '-' are operators alone and signs in front of digits.
+ */
+enum CharClass
 {
-    _stack = other._stack;
-}
+    CLASS_OTHER,
+    CLASS_SPACE,
+    CLASS_DIGIT,
+    CLASS_SIGN,
+    CLASS_OPERATOR
+};
 
-RPN& RPN::operator=(const RPN& other)
+struct CharClassTable
 {
-    if (this != &other)
+    unsigned char classes[256];
+    
+    CharClassTable()
     {
-        _stack = other._stack;
+        for (int c = 0; c < 256; c++)
+            classes[c] = CLASS_OTHER;
+        for (int c = '0'; c <= '9'; c++)
+            classes[c] = CLASS_DIGIT;
+        classes[static_cast<unsigned char>(' ')] = CLASS_SPACE;
+        classes[static_cast<unsigned char>('\t')] = CLASS_SPACE;
+        classes[static_cast<unsigned char>('\n')] = CLASS_SPACE;
+        classes[static_cast<unsigned char>('\v')] = CLASS_SPACE;
+        classes[static_cast<unsigned char>('\f')] = CLASS_SPACE;
+        classes[static_cast<unsigned char>('\r')] = CLASS_SPACE;
+        classes[static_cast<unsigned char>('+')] = CLASS_SIGN;
+        classes[static_cast<unsigned char>('-')] = CLASS_SIGN;
+        classes[static_cast<unsigned char>('*')] = CLASS_OPERATOR;
+        classes[static_cast<unsigned char>('/')] = CLASS_OPERATOR;
     }
-    return *this;
-}
+};
 
-RPN::~RPN()
-{
-}
+static const CharClassTable TABLE;
 
 /**
- * Check if token is an operator
- * Valid operators: +, -, *, /
+ * Up to this many digits a number fits an int as it is
  */
-bool RPN::isOperator(const std::string& token)
+static const size_t SHORT_NUMBER_DIGITS = 9;
+
+RPN::RPN() : _result(0), _errorBegin(NULL), _errorEnd(NULL)
 {
-    return (token == "+" || token == "-" || token == "*" || token == "/");
 }
 
 /**
- * Check if token is a valid number
- * Rules:
- * - Single digit numbers (0-9)
- * - Can have leading negative sign
+ * The stack is scratch space, only the result is copied
  */
-bool RPN::isNumber(const std::string& token)
+RPN::RPN(const RPN& other)
+    : _result(other._result), _errorBegin(other._errorBegin), _errorEnd(other._errorEnd)
 {
-    if (token.empty())
-        return false;
-    
-    // Check for negative sign
-    size_t start = 0;
-    if (token[0] == '-' || token[0] == '+')
-    {
-        if (token.length() < 2)
-            return false;
-        start = 1;
-    }
-    
-    // Check that rest are digits
-    for (size_t i = start; i < token.length(); i++)
+}
+
+RPN& RPN::operator=(const RPN& other)
+{
+    if (this != &other)
     {
-        if (!std::isdigit(token[i]))
-            return false;
+        _result = other._result;
+        _errorBegin = other._errorBegin;
+        _errorEnd = other._errorEnd;
     }
-    
-    return true;
+    return *this;
 }
 
-/**
- * Convert string to integer
- * Simple wrapper around atoi
- */
-int RPN::stringToInt(const std::string& str)
+RPN::~RPN()
 {
-    return std::atoi(str.c_str());
 }
 
 /**
- * Apply an operation to the top two stack elements
- * 
- * Algorithm:
- * 1. Check if stack has at least 2 elements
- * 2. Pop first element (this is the second operand)
- * 3. Pop second element (this is the first operand)
- * 4. Apply operation: first_op operation second_op
- * 5. Push result back
+ * first op second
  * 
- * Important: Order matters!
- * Stack: [5, 3] with "-" means 5 - 3 = 2, NOT 3 - 5
+ * +, - and * wrap around on overflow (two's complement, computed in
+ * unsigned so it is defined behaviour), which is what the plain int
+ * operations did on every supported target. INT_MIN / -1 has no int
+ * result and used to trap (SIGFPE); it is an error here, like
+ * division by zero.
  */
-bool RPN::applyOperation(char op)
+bool RPN::compute(char op, int first, int second, int& result)
 {
-    // Check if we have enough operands
-    if (_stack.size() < 2)
-    {
-        return false;
-    }
-    
-    // Pop operands (note the order!)
-    int second = _stack.top();
-    _stack.pop();
-    int first = _stack.top();
-    _stack.pop();
+    unsigned int a = static_cast<unsigned int>(first);
+    unsigned int b = static_cast<unsigned int>(second);
     
-    int result;
-    
-    // Apply operation
     switch (op)
     {
         case '+':
-            result = first + second;
-            break;
+            result = static_cast<int>(a + b);
+            return true;
         case '-':
-            result = first - second;
-            break;
+            result = static_cast<int>(a - b);
+            return true;
         case '*':
-            result = first * second;
-            break;
+            result = static_cast<int>(a * b);
+            return true;
         case '/':
             // Division by zero check
-            if (second == 0)
-            {
+            if (second == 0 || (second == -1 && first == INT_MIN))
                 return false;
-            }
             result = first / second;
-            break;
+            return true;
         default:
             return false;
     }
+}
+
+/**
+ * std::atoi is strtol cast to int: the value saturates at LONG_MIN /
+ * LONG_MAX, then keeps its low bits. Same here, without needing the
+ * token to be NUL-terminated.
+ */
+int RPN::parseNumber(const char* begin, const char* end)
+{
+    bool negative = (*begin == '-');
+    if (*begin == '-' || *begin == '+')
+        begin++;
+    
+    unsigned long limit = negative ? static_cast<unsigned long>(LONG_MAX) + 1 : LONG_MAX;
+    unsigned long magnitude = 0;
+    for (; begin != end; begin++)
+    {
+        unsigned long digit = static_cast<unsigned long>(*begin - '0');
+        if (magnitude > (limit - digit) / 10)
+        {
+            magnitude = limit;
+            break;
+        }
+        magnitude = magnitude * 10 + digit;
+    }
     
-    // Push result back
-    _stack.push(result);
-    return true;
+    return static_cast<int>(static_cast<unsigned int>(negative ? 0 - magnitude : magnitude));
+}
+
+/**
+ * Operand stack for an expression of length characters
+ */
+int* RPN::stackFor(size_t length)
+{
+    size_t bound = length / 2 + 1;
+    if (bound <= INLINE_DEPTH)
+        return _inline;
+    if (_arena.size() < bound)
+        _arena.resize(bound);
+    return &_arena[0];
 }
 
 /**
@@ -147,51 +168,100 @@ bool RPN::applyOperation(char op)
  */
 bool RPN::evaluate(const std::string& expression)
 {
-    // Clear any previous state
-    while (!_stack.empty())
-        _stack.pop();
+    const char* begin = expression.data();
     
-    // Split expression into tokens
-    std::stringstream ss(expression);
-    std::string token;
+    switch (run(begin, begin + expression.size()))
+    {
+        case STATUS_OK:
+            return true;
+        case STATUS_INVALID_TOKEN:
+            std::cerr << "Error: invalid token: " << getErrorToken() << std::endl;
+            return false;
+        case STATUS_INVALID_OPERATION:
+            std::cerr << "Error: invalid operation or not enough operands" << std::endl;
+            return false;
+        default:
+            std::cerr << "Error: invalid expression (too many numbers)" << std::endl;
+            return false;
+    }
+}
+
+/**
+ * One pass, a token at a time:
+ * 1. Skip spaces
+ * 2. Class of the first character and of the one after it:
+ *    - digit, or sign then digit: a number, which must run to the
+ *      next space (or the end); short ones are summed up on the way
+ *    - operator or sign followed by a space (or the end): an operator
+ *    - anything else, or a number with junk after it: invalid; the
+ *      token runs to the next space
+ * top points one past the top of the stack.
+ */
+RPN::Status RPN::run(const char* begin, const char* end)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(begin);
+    const unsigned char* stop = reinterpret_cast<const unsigned char*>(end);
+    const unsigned char* classes = TABLE.classes;
+    int* base = stackFor(static_cast<size_t>(end - begin));
+    int* top = base;
+    Status status = STATUS_OK;
     
-    while (ss >> token)
+    for (;;)
     {
-        // ===== PROCESS TOKEN =====
+        while (p != stop && classes[*p] == CLASS_SPACE)
+            p++;
+        if (p == stop)
+            break;
         
-        if (isNumber(token))
-        {
-            // It's a number: push onto stack
-            int num = stringToInt(token);
-            _stack.push(num);
-        }
-        else if (isOperator(token))
+        const unsigned char* token = p;
+        unsigned char cls = classes[*p++];
+        unsigned char next = (p == stop) ? static_cast<unsigned char>(CLASS_SPACE) : classes[*p];
+        
+        if (cls == CLASS_DIGIT || (cls == CLASS_SIGN && next == CLASS_DIGIT))
         {
-            // It's an operator: apply operation
-            if (!applyOperation(token[0]))
+            const unsigned char* digits = (cls == CLASS_DIGIT) ? token : p;
+            unsigned int value = 0;
+            for (p = digits; p != stop && classes[*p] == CLASS_DIGIT; p++)
+                value = value * 10 + (*p - '0');
+            if (p == stop || classes[*p] == CLASS_SPACE)
             {
-                std::cerr << "Error: invalid operation or not enough operands" << std::endl;
-                return false;
+                if (static_cast<size_t>(p - digits) > SHORT_NUMBER_DIGITS)
+                    *top++ = parseNumber(reinterpret_cast<const char*>(token),
+                                         reinterpret_cast<const char*>(p));
+                else
+                    *top++ = (*token == '-') ? -static_cast<int>(value) : static_cast<int>(value);
+                continue;
             }
         }
-        else
+        else if ((cls == CLASS_SIGN || cls == CLASS_OPERATOR) && next == CLASS_SPACE)
         {
-            // Invalid token
-            std::cerr << "Error: invalid token: " << token << std::endl;
-            return false;
+            if (top - base < 2)
+            {
+                status = STATUS_INVALID_OPERATION;
+                break;
+            }
+            --top;
+            if (!compute(static_cast<char>(*token), top[-1], top[0], top[-1]))
+            {
+                status = STATUS_INVALID_OPERATION;
+                break;
+            }
+            continue;
         }
+        
+        while (p != stop && classes[*p] != CLASS_SPACE)
+            p++;
+        _errorBegin = reinterpret_cast<const char*>(token);
+        _errorEnd = reinterpret_cast<const char*>(p);
+        status = STATUS_INVALID_TOKEN;
+        break;
     }
     
-    // ===== VALIDATE RESULT =====
-    
     // Stack should have exactly 1 element
-    if (_stack.size() != 1)
-    {
-        std::cerr << "Error: invalid expression (too many numbers)" << std::endl;
-        return false;
-    }
-    
-    return true;
+    if (status == STATUS_OK && top - base != 1)
+        status = STATUS_TOO_MANY_NUMBERS;
+    _result = (top != base) ? top[-1] : 0;
+    return status;
 }
 
 /**
@@ -199,8 +269,12 @@ bool RPN::evaluate(const std::string& expression)
  */
 int RPN::getResult()
 {
-    if (_stack.empty())
-        return 0;
-    
-    return _stack.top();
-}
\ No newline at end of file
+    return _result;
+}
+
+std::string RPN::getErrorToken() const
+{
+    if (_errorBegin == NULL)
+        return std::string();
+    return std::string(_errorBegin, _errorEnd);
+}
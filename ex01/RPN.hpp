@@ -2,10 +2,9 @@
 #define RPN_HPP
 
 #include <string>
-#include <stack>
+#include <vector>
 #include <iostream>
-#include <sstream>
-#include <cstdlib>
+#include <cstddef>
 
 /**
  * RPN (Reverse Polish Notation) Calculator
@@ -20,23 +19,56 @@
  * Example: "3 4 +" becomes (3 + 4) = 7
  * Example: "8 9 * 9 - 9 - 9 - 4 - 1 +" becomes 42
  * 
- * Using std::stack because:
- * - LIFO (Last In First Out) is exactly what RPN needs
- * - push(), pop(), top() are efficient O(1) operations
- * - Natural fit for the algorithm
+ * The expression is read in place, one pass, one character class
+ * lookup per character; tokens are never copied out. The operands
+ * live in a plain int array:
+ * - every token takes a character and the tokens are separated, so
+ *   an expression of n characters never holds more than (n + 1) / 2
+ *   operands; that bound costs nothing to compute
+ * - up to INLINE_DEPTH operands the array is part of the object,
+ *   beyond that it is _arena, which only ever grows
+ * so evaluating allocates nothing once the evaluator has seen its
+ * longest expression.
  */
 class RPN
 {
+public:
+    /**
+     * Outcome of run(); evaluate() prints the matching message
+     */
+    enum Status
+    {
+        STATUS_OK,
+        STATUS_INVALID_TOKEN,       // not a number or operator
+        STATUS_INVALID_OPERATION,   // fewer than two operands, or division error
+        STATUS_TOO_MANY_NUMBERS     // not exactly one value left at the end
+    };
+
+    static const size_t INLINE_DEPTH = 64;
+
 private:
-    std::stack<int> _stack;
-    
-    // Helper methods
-    bool isOperator(const std::string& token);
-    bool isNumber(const std::string& token);
-    bool applyOperation(char op);
-    int stringToInt(const std::string& str);
+    int _inline[INLINE_DEPTH];
+    std::vector<int> _arena;
+    int _result;
+    const char* _errorBegin;        // the invalid token, STATUS_INVALID_TOKEN
+    const char* _errorEnd;
+
+    int* stackFor(size_t length);
 
 public:
+    /**
+     * first op second for op in + - * /, the arithmetic every
+     * evaluation path shares (see RPN.cpp)
+     * Returns false on division by zero (and INT_MIN / -1)
+     */
+    static bool compute(char op, int first, int second, int& result);
+    
+    /**
+     * Value of a number token [begin, end) (optional sign, then
+     * digits), converted as std::atoi does
+     */
+    static int parseNumber(const char* begin, const char* end);
+    
     RPN();
     RPN(const RPN& other);
     RPN& operator=(const RPN& other);
@@ -54,10 +86,20 @@ public:
      */
     bool evaluate(const std::string& expression);
     
+    /**
+     * Evaluate the expression [begin, end) without printing anything
+     * 
+     * The result is getResult(); with STATUS_INVALID_TOKEN the token
+     * is getErrorToken(), valid as long as the expression is.
+     */
+    Status run(const char* begin, const char* end);
+    
     /**
      * Get the result of the last evaluation
      */
     int getResult();
+    
+    std::string getErrorToken() const;
 };
 
-#endif
\ No newline at end of file
+#endif
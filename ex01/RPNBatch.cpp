@@ -0,0 +1,363 @@
+#include "RPNBatch.hpp"
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cerrno>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+/**
+ * A line-aligned piece of a block and its output
+ */
+struct BatchChunk
+{
+    const char* begin;
+    const char* end;
+    std::string out;
+};
+
+/**
+ * One worker's share of a block's chunks, [head, tail), packed into one
+ * word so that both ends move with a single compare-and-swap:
+ * the owner takes chunks from the head, thieves from the tail. Shares
+ * are only filled before the workers start, so head only grows and
+ * tail only shrinks. Padded to a cache line, as every worker polls
+ * the others'.
+ */
+struct ChunkShare
+{
+    uint64_t bounds;                // head << 32 | tail
+    char padding[64 - sizeof(uint64_t)];
+};
+
+static void setShare(ChunkShare& share, size_t head, size_t tail)
+{
+    share.bounds = (static_cast<uint64_t>(head) << 32) | static_cast<uint32_t>(tail);
+}
+
+static bool takeChunk(ChunkShare& share, bool fromHead, size_t& index)
+{
+    for (;;)
+    {
+        uint64_t bounds = __atomic_load_n(&share.bounds, __ATOMIC_RELAXED);
+        uint32_t head = static_cast<uint32_t>(bounds >> 32);
+        uint32_t tail = static_cast<uint32_t>(bounds);
+        if (head >= tail)
+            return false;
+        uint64_t next = fromHead ? bounds + (static_cast<uint64_t>(1) << 32) : bounds - 1;
+        if (__sync_bool_compare_and_swap(&share.bounds, bounds, next))
+        {
+            index = fromHead ? head : tail - 1;
+            return true;
+        }
+    }
+}
+
+struct BatchRound
+{
+    RPNBatch* batch;
+    std::vector<BatchChunk>* chunks;
+    std::vector<ChunkShare>* shares;
+    size_t workers;
+    size_t nextWorker;
+};
+
+/**
+ * Worker: its own share first, then steal from the others, starting
+ * with the next worker's
+ */
+static void* evaluateChunksThread(void* arg)
+{
+    BatchRound* round = static_cast<BatchRound*>(arg);
+    std::vector<ChunkShare>& shares = *round->shares;
+    size_t self = __sync_fetch_and_add(&round->nextWorker, 1);
+    RPNBatch worker;
+    RPNBatch::Stats counts;
+    size_t index;
+
+    for (;;)
+    {
+        bool stolen = false;
+        bool found = takeChunk(shares[self], true, index);
+        for (size_t k = 1; !found && k < round->workers; k++)
+            found = stolen = takeChunk(shares[(self + k) % round->workers], false, index);
+        if (!found)
+            break;
+
+        BatchChunk& chunk = (*round->chunks)[index];
+        worker.evaluateLines(chunk.begin, chunk.end, chunk.out);
+        counts.chunks++;
+        if (stolen)
+            counts.steals++;
+    }
+
+    counts.lines = worker.stats().lines;
+    counts.errors = worker.stats().errors;
+    counts.bytes = worker.stats().bytes;
+    round->batch->merge(counts);
+    return NULL;
+}
+
+static double nowSeconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * Decimal digits of value, written backwards from the end of a small
+ * buffer (no stream, no locale)
+ */
+static void appendInt(std::string& out, int value)
+{
+    char digits[16];
+    char* p = digits + sizeof(digits);
+    unsigned int magnitude = (value < 0) ? 0u - static_cast<unsigned int>(value)
+                                         : static_cast<unsigned int>(value);
+    do
+    {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0)
+        *--p = '-';
+    out.append(p, digits + sizeof(digits) - p);
+}
+
+RPNBatch::Stats::Stats() : lines(0), errors(0), bytes(0), chunks(0), steals(0), seconds(0)
+{
+}
+
+RPNBatch::RPNBatch() : _threads(1)
+{
+}
+
+/**
+ * Buffers are scratch space, only the settings and counters are copied
+ */
+RPNBatch::RPNBatch(const RPNBatch& other) : _stats(other._stats), _threads(other._threads)
+{
+}
+
+RPNBatch& RPNBatch::operator=(const RPNBatch& other)
+{
+    if (this != &other)
+    {
+        _stats = other._stats;
+        _threads = other._threads;
+    }
+    return *this;
+}
+
+RPNBatch::~RPNBatch()
+{
+}
+
+void RPNBatch::setThreadCount(size_t threads)
+{
+    _threads = threads ? threads : 1;
+}
+
+void RPNBatch::evaluateLine(const char* begin, const char* end, std::string& out)
+{
+    if (_rpn.run(begin, end) == RPN::STATUS_OK)
+        appendInt(out, _rpn.getResult());
+    else
+    {
+        out.append("Error", 5);
+        _stats.errors++;
+    }
+    out.push_back('\n');
+    _stats.lines++;
+}
+
+const char* RPNBatch::evaluateLines(const char* begin, const char* end, std::string& out)
+{
+    const char* line = begin;
+    const char* newline;
+
+    while ((newline = static_cast<const char*>(std::memchr(line, '\n', end - line))) != NULL)
+    {
+        evaluateLine(line, newline, out);
+        line = newline + 1;
+    }
+    _stats.bytes += line - begin;
+    return line;
+}
+
+/**
+ * The complete lines of [begin, end), on _threads workers; the calling
+ * thread is one of them. Returns where the unfinished line starts.
+ */
+const char* RPNBatch::evaluateParallel(const char* begin, const char* end,
+                                       std::vector<BatchChunk>& chunks)
+{
+    const char* stop = end;
+    while (stop != begin && stop[-1] != '\n')
+        stop--;
+
+    // Cut line-aligned chunks (their buffers keep their capacity)
+    size_t used = 0;
+    for (const char* p = begin; p < stop; used++)
+    {
+        const char* cut = stop;
+        if (static_cast<size_t>(stop - p) > CHUNK_BYTES)
+            cut = static_cast<const char*>(std::memchr(p + CHUNK_BYTES - 1, '\n',
+                                                       stop - (p + CHUNK_BYTES - 1))) + 1;
+        if (used == chunks.size())
+            chunks.resize(used + 1);
+        chunks[used].begin = p;
+        chunks[used].end = cut;
+        chunks[used].out.clear();
+        p = cut;
+    }
+    if (used == 0)
+        return begin;
+
+    // Contiguous shares, the first used % workers one chunk longer
+    size_t workers = (_threads < used) ? _threads : used;
+    std::vector<ChunkShare> shares(workers);
+    for (size_t w = 0, head = 0; w < workers; w++)
+    {
+        size_t size = used / workers + (w < used % workers ? 1 : 0);
+        setShare(shares[w], head, head + size);
+        head += size;
+    }
+
+    BatchRound round;
+    round.batch = this;
+    round.chunks = &chunks;
+    round.shares = &shares;
+    round.workers = workers;
+    round.nextWorker = 0;
+
+    std::vector<pthread_t> tids(workers);
+    std::vector<bool> started(workers);
+    for (size_t i = 1; i < workers; i++)
+        started[i] = (pthread_create(&tids[i], NULL, evaluateChunksThread, &round) == 0);
+    evaluateChunksThread(&round);
+    for (size_t i = 1; i < workers; i++)
+    {
+        if (started[i])
+            pthread_join(tids[i], NULL);
+    }
+
+    // Output in input order
+    for (size_t i = 0; i < used; i++)
+        _output.append(chunks[i].out);
+    return stop;
+}
+
+bool RPNBatch::flush(int fd)
+{
+    const char* p = _output.data();
+    size_t left = _output.size();
+
+    while (left > 0)
+    {
+        ssize_t n = write(fd, p, left);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Error: cannot write output: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    _output.clear();
+    return true;
+}
+
+/**
+ * _input holds [0, used): the unfinished line of the previous block,
+ * then the new block. When the unfinished line fills the buffer, the
+ * buffer doubles.
+ */
+bool RPNBatch::process(int inFd, int outFd)
+{
+    double start = nowSeconds();
+    size_t used = 0;
+    size_t block = (_threads > 1) ? _threads * CHUNKS_PER_THREAD * CHUNK_BYTES : READ_BYTES;
+    std::vector<BatchChunk> chunks;
+
+    if (_input.size() < block)
+        _input.resize(block);
+    _output.reserve(WRITE_BYTES + READ_BYTES);
+
+    for (;;)
+    {
+        if (used == _input.size())
+            _input.resize(_input.size() * 2);
+
+        ssize_t n = read(inFd, &_input[0] + used, _input.size() - used);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Error: cannot read input: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (n == 0)
+            break;
+
+        const char* begin = &_input[0];
+        const char* end = begin + used + n;
+        const char* rest = (_threads > 1) ? evaluateParallel(begin, end, chunks)
+                                          : evaluateLines(begin, end, _output);
+        used = end - rest;
+        std::memmove(&_input[0], rest, used);
+
+        if (_output.size() >= WRITE_BYTES && !flush(outFd))
+            return false;
+    }
+
+    if (used > 0)
+    {
+        evaluateLine(&_input[0], &_input[0] + used, _output);
+        _stats.bytes += used;
+    }
+    _stats.seconds += nowSeconds() - start;
+    return flush(outFd);
+}
+
+const RPNBatch::Stats& RPNBatch::stats() const
+{
+    return _stats;
+}
+
+void RPNBatch::merge(const Stats& stats)
+{
+    __sync_fetch_and_add(&_stats.lines, stats.lines);
+    __sync_fetch_and_add(&_stats.errors, stats.errors);
+    __sync_fetch_and_add(&_stats.bytes, stats.bytes);
+    __sync_fetch_and_add(&_stats.chunks, stats.chunks);
+    __sync_fetch_and_add(&_stats.steals, stats.steals);
+}
+
+/**
+ * lines 1000000 errors 125000 bytes 52 MB time 0.61 s: 1.64 M lines/s,
+ * 610 ns/line, 85.2 MB/s (+ chunks 850 steals 12 with threads)
+ */
+void RPNBatch::printStats(std::ostream& out, const Stats& stats)
+{
+    double seconds = (stats.seconds > 0) ? stats.seconds : 1e-9;
+    double lines = (stats.lines > 0) ? static_cast<double>(stats.lines) : 1;
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2)
+        << "lines " << stats.lines << " errors " << stats.errors
+        << " bytes " << stats.bytes << " time " << stats.seconds << " s: "
+        << stats.lines / seconds / 1e6 << " M lines/s, "
+        << std::setprecision(1) << seconds * 1e9 / lines << " ns/line, "
+        << stats.bytes / seconds / 1e6 << " MB/s";
+    if (stats.chunks > 0)
+        out << ", chunks " << stats.chunks << " steals " << stats.steals;
+    out << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,110 @@
+#ifndef RPN_BATCH_HPP
+#define RPN_BATCH_HPP
+
+#include "RPN.hpp"
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * RPNBatch: evaluate a stream of expressions, one per line
+ * 
+ * Each line gets one output line, in input order: the result, or
+ * "Error" (the reason is not printed; it would cost more than the
+ * evaluation). An empty line is an error, as "" is for ./RPN.
+ * 
+ * The input is read in blocks of READ_BYTES into one buffer; the
+ * complete lines of a block are evaluated in place by a single RPN,
+ * whose stack is reused from line to line, and the unfinished last
+ * line is moved to the front for the next read. A line longer than
+ * the buffer makes it grow. The output collects in a string that is
+ * written out whenever it passes WRITE_BYTES. After the first blocks
+ * nothing is allocated.
+ * 
+ * With several threads (setThreadCount) each block holds
+ * CHUNKS_PER_THREAD chunks per thread, cut after a '\n' every
+ * CHUNK_BYTES. Every worker has its own RPN and output buffers and
+ * starts on its own contiguous share of the chunks; a worker that runs
+ * out steals chunks from the far end of another's share, so a chunk of
+ * very long lines delays only itself. The chunk outputs are appended
+ * in input order once the block is done.
+ */
+struct BatchChunk;
+
+class RPNBatch
+{
+public:
+    static const size_t READ_BYTES = 1 << 20;
+    static const size_t WRITE_BYTES = 1 << 16;
+    static const size_t CHUNK_BYTES = 1 << 16;
+    static const size_t CHUNKS_PER_THREAD = 16;
+
+    /**
+     * Counters of the lines evaluated so far
+     */
+    struct Stats
+    {
+        uint64_t lines;
+        uint64_t errors;
+        uint64_t bytes;
+        uint64_t chunks;            // processed by a worker thread
+        uint64_t steals;            // of those, taken from another's share
+        double seconds;             // wall clock of process()
+
+        Stats();
+    };
+
+private:
+    RPN _rpn;
+    std::vector<char> _input;
+    std::string _output;
+    Stats _stats;
+    size_t _threads;
+
+    bool flush(int fd);
+    const char* evaluateParallel(const char* begin, const char* end, std::vector<BatchChunk>& chunks);
+
+public:
+    RPNBatch();
+    RPNBatch(const RPNBatch& other);
+    RPNBatch& operator=(const RPNBatch& other);
+    ~RPNBatch();
+
+    /**
+     * Threads evaluating the lines of process() (at least 1)
+     */
+    void setThreadCount(size_t threads);
+
+    /**
+     * Evaluate every complete line of [begin, end) (the part after the
+     * last '\n' is left alone) and append their output lines to out;
+     * returns where the unfinished line starts
+     */
+    const char* evaluateLines(const char* begin, const char* end, std::string& out);
+
+    /**
+     * Evaluate the last line of the input, which has no '\n'
+     */
+    void evaluateLine(const char* begin, const char* end, std::string& out);
+
+    /**
+     * Read inFd to its end, write the output to outFd; false (after
+     * printing why) if reading or writing fails
+     */
+    bool process(int inFd, int outFd);
+
+    const Stats& stats() const;
+
+    /**
+     * Add a worker's counters into this; safe against concurrent merges
+     */
+    void merge(const Stats& stats);
+
+    /**
+     * Lines, errors, bytes, time and throughput, one line
+     */
+    static void printStats(std::ostream& out, const Stats& stats);
+};
+
+#endif
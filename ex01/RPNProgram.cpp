@@ -0,0 +1,472 @@
+#include "RPNProgram.hpp"
+#include "RPN.hpp"
+#include <iostream>
+#include <sstream>
+#include <cctype>
+#include <climits>
+#include <algorithm>
+
+/**
+ * Token rules of RPN::evaluate: optional sign, then digits
+ */
+static bool isNumberToken(const std::string& token)
+{
+    size_t start = (token[0] == '-' || token[0] == '+') ? 1 : 0;
+    if (start == token.length())
+        return false;
+    for (size_t i = start; i < token.length(); i++)
+    {
+        if (!std::isdigit(static_cast<unsigned char>(token[i])))
+            return false;
+    }
+    return true;
+}
+
+static bool isVariableToken(const std::string& token)
+{
+    if (!std::isalpha(static_cast<unsigned char>(token[0])) && token[0] != '_')
+        return false;
+    for (size_t i = 1; i < token.length(); i++)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(token[i])) && token[i] != '_')
+            return false;
+    }
+    return true;
+}
+
+RPNProgram::RPNProgram() : _stackSize(0)
+{
+}
+
+RPNProgram::RPNProgram(const RPNProgram& other)
+    : _code(other._code), _variables(other._variables),
+      _stackSize(other._stackSize), _scratch(other._scratch)
+{
+}
+
+RPNProgram& RPNProgram::operator=(const RPNProgram& other)
+{
+    if (this != &other)
+    {
+        _code = other._code;
+        _variables = other._variables;
+        _stackSize = other._stackSize;
+        _scratch = other._scratch;
+    }
+    return *this;
+}
+
+RPNProgram::~RPNProgram()
+{
+}
+
+/**
+ * One pass over the tokens, tracking the stack depth each instruction
+ * leaves behind:
+ * - number, variable: depth + 1
+ * - operator: needs depth >= 2, leaves depth - 1
+ * - at the end the depth must be exactly 1
+ * The largest depth seen is the stack run() needs.
+ */
+bool RPNProgram::compile(const std::string& expression)
+{
+    _code.clear();
+    _variables.clear();
+    _stackSize = 0;
+
+    std::stringstream ss(expression);
+    std::string token;
+    size_t depth = 0;
+
+    while (ss >> token)
+    {
+        Instruction in;
+
+        if (isNumberToken(token))
+        {
+            in.op = OP_PUSH;
+            in.operand = RPN::parseNumber(token.data(), token.data() + token.length());
+            depth++;
+        }
+        else if (token.length() == 1 && (token[0] == '+' || token[0] == '-'
+                                         || token[0] == '*' || token[0] == '/'))
+        {
+            if (depth < 2)
+            {
+                std::cerr << "Error: invalid operation or not enough operands" << std::endl;
+                return false;
+            }
+            in.op = static_cast<unsigned char>(token[0]);
+            in.operand = 0;
+            depth--;
+        }
+        else if (isVariableToken(token))
+        {
+            size_t slot = findVariable(token);
+            if (slot == _variables.size())
+                _variables.push_back(token);
+            in.op = OP_LOAD;
+            in.operand = static_cast<int>(slot);
+            depth++;
+        }
+        else
+        {
+            std::cerr << "Error: invalid token: " << token << std::endl;
+            return false;
+        }
+
+        _code.push_back(in);
+        if (depth > _stackSize)
+            _stackSize = depth;
+    }
+
+    if (depth != 1)
+    {
+        std::cerr << "Error: invalid expression (too many numbers)" << std::endl;
+        return false;
+    }
+
+    _scratch.assign(_stackSize, 0);
+    return true;
+}
+
+/**
+ * What optimize() knows of a value on the stack: the code computing it
+ * starts at code[start] and runs to the next entry's start (or the
+ * end); constant values are always a single PUSH
+ */
+struct FoldEntry
+{
+    size_t start;
+    bool constant;
+    int value;
+};
+
+/**
+ * The instructions are replayed onto a new list, with a stack of
+ * FoldEntry beside it:
+ * - two constants: computed now with RPN::compute, so with the same
+ *   wrap-around as at run time, and replaced by one PUSH. A division
+ *   that would fail stays, to fail at run time as before.
+ * - a constant that leaves the other operand unchanged (x 0 +, 0 x +,
+ *   x 0 -, x 1 *, 1 x *, x 1 /): the PUSH and the operator go, the
+ *   other operand's code stays, with whatever divisions it holds
+ * Nothing is folded through a variable: x 0 * is 0 only if x cannot
+ * fail, and x x - likewise. The stack only gets shallower, stackSize()
+ * is computed again.
+ */
+size_t RPNProgram::optimize()
+{
+    std::vector<Instruction> code;
+    std::vector<FoldEntry> stack;
+
+    code.reserve(_code.size());
+    stack.reserve(_stackSize);
+    for (size_t k = 0; k < _code.size(); k++)
+    {
+        const Instruction& in = _code[k];
+        if (in.op == OP_PUSH || in.op == OP_LOAD)
+        {
+            FoldEntry entry;
+            entry.start = code.size();
+            entry.constant = (in.op == OP_PUSH);
+            entry.value = in.operand;
+            stack.push_back(entry);
+            code.push_back(in);
+            continue;
+        }
+
+        FoldEntry b = stack.back();
+        stack.pop_back();
+        FoldEntry& a = stack.back();
+        char op = static_cast<char>(in.op);
+        int folded;
+
+        if (a.constant && b.constant && RPN::compute(op, a.value, b.value, folded))
+        {
+            code.resize(a.start);
+            Instruction push;
+            push.op = OP_PUSH;
+            push.operand = folded;
+            code.push_back(push);
+            a.value = folded;
+        }
+        else if (b.constant && ((b.value == 0 && (op == '+' || op == '-'))
+                                || (b.value == 1 && (op == '*' || op == '/'))))
+            code.resize(b.start);
+        else if (a.constant && ((a.value == 0 && op == '+') || (a.value == 1 && op == '*')))
+        {
+            code.erase(code.begin() + a.start);
+            a.constant = b.constant;
+            a.value = b.value;
+        }
+        else
+        {
+            code.push_back(in);
+            a.constant = false;
+        }
+    }
+
+    size_t removed = _code.size() - code.size();
+    _code = code;
+
+    size_t depth = 0;
+    _stackSize = 0;
+    for (size_t k = 0; k < _code.size(); k++)
+    {
+        if (_code[k].op == OP_PUSH || _code[k].op == OP_LOAD)
+            depth++;
+        else
+            depth--;
+        if (depth > _stackSize)
+            _stackSize = depth;
+    }
+    _scratch.assign(_stackSize, 0);
+    return removed;
+}
+
+/**
+ * top points one past the top of the stack. compile() has checked
+ * every operator has two operands, so there are no depth checks here.
+ */
+bool RPNProgram::run(const int* variables, int& result, int* stack) const
+{
+    const Instruction* in = &_code[0];
+    const Instruction* end = in + _code.size();
+    int* top = stack;
+
+    for (; in != end; ++in)
+    {
+        switch (in->op)
+        {
+            case OP_PUSH:
+                *top++ = in->operand;
+                break;
+            case OP_LOAD:
+                *top++ = variables[in->operand];
+                break;
+            default:
+                --top;
+                if (!RPN::compute(static_cast<char>(in->op), top[-1], top[0], top[-1]))
+                    return false;
+                break;
+        }
+    }
+
+    result = stack[0];
+    return true;
+}
+
+bool RPNProgram::run(const int* variables, int& result)
+{
+    return run(variables, result, &_scratch[0]);
+}
+
+/**
+ * A stack entry of runColumns: one value for the whole block (numbers,
+ * and operations on them), or one per row, either read straight from
+ * a column or computed into a scratch block
+ */
+struct ColumnSlot
+{
+    const int* rows;
+    int value;
+    bool constant;
+};
+
+static const size_t BLOCK = RPNProgram::COLUMN_BLOCK;
+
+/**
+ * + - * on a block, in unsigned so they wrap as RPN::compute does.
+ * Whole blocks and no aliasing (dst is never an operand) make plain
+ * loops the compiler vectorizes at -O2.
+ */
+struct AddRows
+{
+    static unsigned int apply(unsigned int a, unsigned int b) { return a + b; }
+};
+
+struct SubtractRows
+{
+    static unsigned int apply(unsigned int a, unsigned int b) { return a - b; }
+};
+
+struct MultiplyRows
+{
+    static unsigned int apply(unsigned int a, unsigned int b) { return a * b; }
+};
+
+template <class Op>
+static void rowsByRows(const int* __restrict__ a, const int* __restrict__ b, int* __restrict__ dst)
+{
+    for (size_t i = 0; i < BLOCK; i++)
+        dst[i] = static_cast<int>(Op::apply(static_cast<unsigned int>(a[i]),
+                                            static_cast<unsigned int>(b[i])));
+}
+
+template <class Op>
+static void rowsByValue(const int* __restrict__ a, int b, int* __restrict__ dst)
+{
+    for (size_t i = 0; i < BLOCK; i++)
+        dst[i] = static_cast<int>(Op::apply(static_cast<unsigned int>(a[i]),
+                                            static_cast<unsigned int>(b)));
+}
+
+template <class Op>
+static void valueByRows(int a, const int* __restrict__ b, int* __restrict__ dst)
+{
+    for (size_t i = 0; i < BLOCK; i++)
+        dst[i] = static_cast<int>(Op::apply(static_cast<unsigned int>(a),
+                                            static_cast<unsigned int>(b[i])));
+}
+
+template <class Op>
+static void arithmeticRows(const ColumnSlot& a, const ColumnSlot& b, int* dst)
+{
+    if (!a.constant && !b.constant)
+        rowsByRows<Op>(a.rows, b.rows, dst);
+    else if (!a.constant)
+        rowsByValue<Op>(a.rows, b.value, dst);
+    else
+        valueByRows<Op>(a.value, b.rows, dst);
+}
+
+/**
+ * Division without branches: a row whose division fails (by zero, or
+ * INT_MIN / -1) is marked in failed and divided by 1 instead. There is
+ * no vector integer division, this loop stays scalar.
+ */
+static void divideRows(const ColumnSlot& a, const ColumnSlot& b, int* dst, unsigned char* failed)
+{
+    for (size_t i = 0; i < BLOCK; i++)
+    {
+        int first = a.constant ? a.value : a.rows[i];
+        int second = b.constant ? b.value : b.rows[i];
+        int fail = (second == 0) | ((second == -1) & (first == INT_MIN));
+        failed[i] |= static_cast<unsigned char>(fail);
+        dst[i] = first / (fail ? 1 : second);
+    }
+}
+
+/**
+ * Per block of COLUMN_BLOCK rows, the instructions in order, on a
+ * stack of ColumnSlot:
+ * - LOAD points at the block of its column (no copy)
+ * - PUSH, and operators on two constants, stay one value
+ * - any other operator writes a scratch block of the depth its result
+ *   lands at; each depth has two, used in turn, so the result never
+ *   overwrites the operand it is computed from
+ * The last, partial block is copied into zero-padded blocks first, so
+ * every loop runs COLUMN_BLOCK times.
+ * A row whose division fails keeps being computed (with a divisor of
+ * 1) and is only marked; rows cannot fail in any other way, so that is
+ * exactly the rows run() would fail on.
+ */
+size_t RPNProgram::runColumns(const int* const* columns, size_t rows, int* out, unsigned char* ok) const
+{
+    std::vector<int> scratch(_stackSize * 2 * BLOCK);
+    std::vector<int> tail(_variables.size() * BLOCK);
+    std::vector<ColumnSlot> stack(_stackSize);
+    unsigned char failed[BLOCK];
+    size_t failures = 0;
+
+    for (size_t start = 0; start < rows; start += BLOCK)
+    {
+        size_t n = (rows - start < BLOCK) ? rows - start : BLOCK;
+        size_t depth = 0;
+        bool allFailed = false;
+
+        if (n < BLOCK)
+        {
+            for (size_t v = 0; v < _variables.size(); v++)
+                std::copy(columns[v] + start, columns[v] + start + n, &tail[v * BLOCK]);
+        }
+
+        std::fill(failed, failed + BLOCK, 0);
+        for (size_t k = 0; k < _code.size(); k++)
+        {
+            const Instruction& in = _code[k];
+            if (in.op == OP_PUSH || in.op == OP_LOAD)
+            {
+                ColumnSlot& slot = stack[depth++];
+                slot.constant = (in.op == OP_PUSH);
+                slot.value = in.operand;
+                if (slot.constant)
+                    slot.rows = NULL;
+                else if (n < BLOCK)
+                    slot.rows = &tail[in.operand * BLOCK];
+                else
+                    slot.rows = columns[in.operand] + start;
+                continue;
+            }
+
+            depth--;
+            ColumnSlot& a = stack[depth - 1];
+            const ColumnSlot& b = stack[depth];
+            if (a.constant && b.constant)
+            {
+                allFailed |= !RPN::compute(static_cast<char>(in.op), a.value, b.value, a.value);
+                continue;
+            }
+
+            int* dst = &scratch[(depth - 1) * 2 * BLOCK];
+            if (a.rows == dst)
+                dst += BLOCK;
+            switch (in.op)
+            {
+                case OP_ADD:
+                    arithmeticRows<AddRows>(a, b, dst);
+                    break;
+                case OP_SUB:
+                    arithmeticRows<SubtractRows>(a, b, dst);
+                    break;
+                case OP_MUL:
+                    arithmeticRows<MultiplyRows>(a, b, dst);
+                    break;
+                default:
+                    divideRows(a, b, dst, failed);
+                    break;
+            }
+            a.rows = dst;
+            a.constant = false;
+        }
+
+        const ColumnSlot& result = stack[0];
+        for (size_t i = 0; i < n; i++)
+        {
+            unsigned char good = !(failed[i] | allFailed);
+            ok[start + i] = good;
+            out[start + i] = good ? (result.constant ? result.value : result.rows[i]) : 0;
+            failures += !good;
+        }
+    }
+    return failures;
+}
+
+size_t RPNProgram::stackSize() const
+{
+    return _stackSize;
+}
+
+size_t RPNProgram::variableCount() const
+{
+    return _variables.size();
+}
+
+const std::string& RPNProgram::variableName(size_t index) const
+{
+    return _variables[index];
+}
+
+size_t RPNProgram::findVariable(const std::string& name) const
+{
+    size_t i = 0;
+    while (i < _variables.size() && _variables[i] != name)
+        i++;
+    return i;
+}
+
+const std::vector<RPNProgram::Instruction>& RPNProgram::code() const
+{
+    return _code;
+}
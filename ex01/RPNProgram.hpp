@@ -0,0 +1,114 @@
+#ifndef RPN_PROGRAM_HPP
+#define RPN_PROGRAM_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * RPNProgram: an RPN expression compiled once, run many times
+ * 
+ * compile() turns the expression into a flat list of instructions:
+ * 
+ *   "x 3 * y -"  ->  LOAD x, PUSH 3, MUL, LOAD y, SUB
+ * 
+ * Besides numbers and operators the expression may use variables:
+ * names made of letters, digits and '_' that do not start with a
+ * digit. Each gets a slot (in order of first use), and run() reads
+ * the value of slot i from variables[i].
+ * 
+ * Every check that does not depend on the values is done by compile():
+ * invalid tokens, an operator without two operands, more than one
+ * value left at the end. The stack depth at each instruction is known
+ * then too, so run() needs no checks besides division, and the stack
+ * it works on is sized once (stackSize()). run() parses nothing and
+ * allocates nothing.
+ * 
+ * runColumns() runs the program over whole columns, one instruction
+ * at a time over blocks of COLUMN_BLOCK rows (see RPNProgram.cpp).
+ * 
+ * optimize() shortens the program without changing any result or
+ * error: "8 9 * 9 - x +" runs as "63 x +".
+ */
+class RPNProgram
+{
+public:
+    enum OpCode
+    {
+        OP_PUSH,            // push operand
+        OP_LOAD,            // push variables[operand]
+        OP_ADD = '+',       // arithmetic: the operator character,
+        OP_SUB = '-',       // as RPN::compute takes it
+        OP_MUL = '*',
+        OP_DIV = '/'
+    };
+
+    struct Instruction
+    {
+        int operand;
+        unsigned char op;
+    };
+
+    static const size_t COLUMN_BLOCK = 1024;
+
+private:
+    std::vector<Instruction> _code;
+    std::vector<std::string> _variables;
+    size_t _stackSize;
+    std::vector<int> _scratch;      // stack of the two-argument run()
+
+public:
+    RPNProgram();
+    RPNProgram(const RPNProgram& other);
+    RPNProgram& operator=(const RPNProgram& other);
+    ~RPNProgram();
+
+    /**
+     * Compile an expression; on error, print why to std::cerr (the
+     * messages of RPN::evaluate) and return false
+     */
+    bool compile(const std::string& expression);
+
+    /**
+     * Fold operations on constants and drop operations that leave
+     * their other operand unchanged (x 0 +, 0 x +, x 0 -, x 1 *,
+     * 1 x *, x 1 /); returns the number of instructions removed
+     */
+    size_t optimize();
+
+    /**
+     * Run with variables[i] as the value of variable i
+     * 
+     * stack must have room for stackSize() ints; threads running the
+     * same program each pass their own. Returns false on division by
+     * zero.
+     */
+    bool run(const int* variables, int& result, int* stack) const;
+
+    /**
+     * Same, on a stack owned by the program (not thread-safe)
+     */
+    bool run(const int* variables, int& result);
+
+    /**
+     * For each row r < rows: out[r] = the program with variable i set
+     * to columns[i][r], and ok[r] = 1; or, if a division of that row
+     * fails, out[r] = 0 and ok[r] = 0. Returns the number of failed
+     * rows. Thread-safe.
+     */
+    size_t runColumns(const int* const* columns, size_t rows, int* out, unsigned char* ok) const;
+
+    size_t stackSize() const;
+    size_t variableCount() const;
+    const std::string& variableName(size_t index) const;
+
+    /**
+     * Slot of a variable, or variableCount() if the program has none
+     * of that name
+     */
+    size_t findVariable(const std::string& name) const;
+
+    const std::vector<Instruction>& code() const;
+};
+
+#endif
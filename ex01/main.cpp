@@ -1,5 +1,148 @@
 #include "RPN.hpp"
+#include "RPNProgram.hpp"
+#include "RPNBatch.hpp"
 #include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * ./RPN --batch [-j threads] [--stats] [file]
+ * One expression per line of file (stdin if none, or "-"); one result
+ * or "Error" per line on stdout, in input order whatever the number of
+ * threads. --stats prints the throughput to stderr.
+ */
+static int runBatch(int argc, char** argv)
+{
+    bool stats = false;
+    const char* path = NULL;
+    size_t threads = 1;
+    
+    for (int i = 2; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--stats") == 0)
+            stats = true;
+        else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            int n = std::atoi(argv[++i]);
+            if (n < 1)
+            {
+                std::cerr << "Error: invalid thread count." << std::endl;
+                return 1;
+            }
+            threads = static_cast<size_t>(n);
+        }
+        else if (path == NULL)
+            path = argv[i];
+        else
+        {
+            std::cerr << "Error" << std::endl;
+            return 1;
+        }
+    }
+    
+    int fd = STDIN_FILENO;
+    if (path != NULL && std::strcmp(path, "-") != 0)
+    {
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            std::cerr << "Error: cannot open " << path << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+    }
+    
+    RPNBatch batch;
+    batch.setThreadCount(threads);
+    bool ok = batch.process(fd, STDOUT_FILENO);
+    if (fd != STDIN_FILENO)
+        close(fd);
+    if (stats)
+        RPNBatch::printStats(std::cerr, batch.stats());
+    return ok ? 0 : 1;
+}
+
+/**
+ * name=value, value an integer (optional sign, digits)
+ */
+static bool parseBinding(const std::string& arg, std::string& name, int& value)
+{
+    size_t eq = arg.find('=');
+    if (eq == std::string::npos || eq == 0)
+        return false;
+    name = arg.substr(0, eq);
+    std::string text = arg.substr(eq + 1);
+    size_t i = (!text.empty() && (text[0] == '-' || text[0] == '+')) ? 1 : 0;
+    if (i == text.length())
+        return false;
+    for (; i < text.length(); i++)
+    {
+        if (!std::isdigit(static_cast<unsigned char>(text[i])))
+            return false;
+    }
+    value = std::atoi(text.c_str());
+    return true;
+}
+
+/**
+ * ./RPN "expression" name=value...
+ * Compile the expression, bind every variable, run it
+ */
+static int runProgram(int argc, char** argv)
+{
+    RPNProgram program;
+    if (!program.compile(argv[1]))
+    {
+        std::cerr << "Error" << std::endl;
+        return 1;
+    }
+    
+    std::vector<int> values(program.variableCount(), 0);
+    std::vector<bool> bound(program.variableCount(), false);
+    for (int i = 2; i < argc; i++)
+    {
+        std::string name;
+        int value;
+        if (!parseBinding(argv[i], name, value))
+        {
+            std::cerr << "Error: invalid binding: " << argv[i] << std::endl;
+            std::cerr << "Error" << std::endl;
+            return 1;
+        }
+        size_t slot = program.findVariable(name);
+        if (slot == program.variableCount())
+        {
+            std::cerr << "Error: unknown variable: " << name << std::endl;
+            std::cerr << "Error" << std::endl;
+            return 1;
+        }
+        values[slot] = value;
+        bound[slot] = true;
+    }
+    for (size_t i = 0; i < program.variableCount(); i++)
+    {
+        if (!bound[i])
+        {
+            std::cerr << "Error: unbound variable: " << program.variableName(i) << std::endl;
+            std::cerr << "Error" << std::endl;
+            return 1;
+        }
+    }
+    
+    int result;
+    if (!program.run(values.empty() ? NULL : &values[0], result))
+    {
+        std::cerr << "Error: invalid operation or not enough operands" << std::endl;
+        std::cerr << "Error" << std::endl;
+        return 1;
+    }
+    std::cout << result << std::endl;
+    return 0;
+}
 
 /**
  * RPN Calculator Program
@@ -19,16 +162,29 @@
  * Error cases:
  * ./RPN "(1 + 1)"
  * Output: Error
+ * 
+ * With variables (see RPNProgram):
+ * ./RPN "x 3 * y -" x=15 y=3
+ * Output: 42
+ * 
+ * Many expressions, one per line (see RPNBatch):
+ * ./RPN --batch expressions.txt
  */
 int main(int argc, char** argv)
 {
     // Check argument count
-    if (argc != 2)
+    if (argc < 2)
     {
         std::cerr << "Error" << std::endl;
         return 1;
     }
     
+    if (std::strcmp(argv[1], "--batch") == 0)
+        return runBatch(argc, argv);
+    
+    if (argc > 2)
+        return runProgram(argc, argv);
+    
     // Create RPN calculator
     RPN rpn;
     
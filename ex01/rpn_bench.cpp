@@ -0,0 +1,690 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stack>
+#include <new>
+#include <cstdlib>
+#include <cctype>
+#include <stdint.h>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "RPN.hpp"
+#include "RPNBatch.hpp"
+#include "RPNProgram.hpp"
+
+/**
+ * rpn_bench: benchmarks of the RPN evaluators
+ * 
+ * Usage: ./rpn_bench tokens [expressions [tokens]]
+ *        ./rpn_bench batch [expressions [tokens]]
+ *        ./rpn_bench scaling [expressions [threads]]
+ *        ./rpn_bench columns [rows [expression]]
+ *        ./rpn_bench optimize [evaluations [expression]]
+ * 
+ * tokens: `expressions` generated expressions (default 200000) of
+ * about `tokens` tokens each (default 15), one in eight of them
+ * invalid, evaluated with the stringstream / std::stack evaluator
+ * RPN used to have (legacy, below) and with RPN::run. Prints tokens
+ * per second and heap allocations per expression of each; both must
+ * agree on every status and result.
+ * 
+ * batch: the same expressions (default 1000000), one per line, in a
+ * file under /tmp, run through RPNBatch::process with the output sent
+ * to /dev/null. Prints tokens and lines per second.
+ * 
+ * scaling: a mixed corpus (default 1000000 lines): mostly 3 to 8
+ * tokens, a quarter 15 to 40, and one line in a thousand of 2000 to
+ * 5000 tokens, clustered in runs so that some chunks are all long
+ * lines. RPNBatch::process on 1 to `threads` threads (default: the
+ * online CPUs), output to a file under /tmp; prints lines per second,
+ * speedup over 1 thread and steals, and checks every output is the
+ * same.
+ * 
+ * columns: a compiled expression (default: a few, with and without
+ * division) over `rows` rows (default 10000000) of random values in
+ * [-1000, 1000] per variable, row by row with RPNProgram::run and
+ * with runColumns. Prints rows per second; both must give the same
+ * values and failed rows.
+ * 
+ * optimize: an expression (default: a few with constant parts and
+ * identities) compiled, and compiled then optimized; prints the
+ * instructions removed and the time of `evaluations` runs (default
+ * 10000000) of each with changing variables. Then checks optimize()
+ * on 100000 random programs mixing variables and the constants 0, 1,
+ * -1, 0x7fffffff and INT_MIN: same result or failure on random
+ * bindings.
+ */
+
+static const int RUNS = 5;
+
+/**
+ * Every operator new of the process is counted (not inlined, or GCC
+ * takes the free() below for a mismatched delete)
+ */
+static size_t g_allocations = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc) __attribute__((noinline));
+void operator delete(void* p) throw() __attribute__((noinline));
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+    g_allocations++;
+    void* p = std::malloc(size ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) throw()
+{
+    std::free(p);
+}
+
+static double nowSeconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * splitmix64: small, seedable and the same on every platform
+ */
+static uint64_t nextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static size_t randomBelow(uint64_t& state, size_t n)
+{
+    return static_cast<size_t>(nextRandom(state) % n);
+}
+
+/**
+ * The evaluator as it was before RPN::run: stringstream tokens,
+ * std::string compares, std::stack<int>
+ */
+static bool legacyIsNumber(const std::string& token)
+{
+    size_t start = 0;
+    if (token[0] == '-' || token[0] == '+')
+    {
+        if (token.length() < 2)
+            return false;
+        start = 1;
+    }
+    for (size_t i = start; i < token.length(); i++)
+    {
+        if (!std::isdigit(token[i]))
+            return false;
+    }
+    return true;
+}
+
+static RPN::Status legacyEvaluate(const std::string& expression, int& result)
+{
+    std::stack<int> stack;
+    std::stringstream ss(expression);
+    std::string token;
+
+    while (ss >> token)
+    {
+        if (legacyIsNumber(token))
+            stack.push(std::atoi(token.c_str()));
+        else if (token == "+" || token == "-" || token == "*" || token == "/")
+        {
+            if (stack.size() < 2)
+                return RPN::STATUS_INVALID_OPERATION;
+            int second = stack.top();
+            stack.pop();
+            int first = stack.top();
+            stack.pop();
+            int value;
+            if (!RPN::compute(token[0], first, second, value))
+                return RPN::STATUS_INVALID_OPERATION;
+            stack.push(value);
+        }
+        else
+            return RPN::STATUS_INVALID_TOKEN;
+    }
+    if (stack.size() != 1)
+        return RPN::STATUS_TOO_MANY_NUMBERS;
+    result = stack.top();
+    return RPN::STATUS_OK;
+}
+
+/**
+ * A valid expression of about `tokens` tokens: operands are numbers
+ * up to 3 digits, operators mostly + - *, rarely /. One in eight is
+ * broken: a stray letter, a missing operand or an extra number.
+ */
+static std::string generateExpression(uint64_t& state, size_t tokens, size_t& count)
+{
+    static const char OPERATORS[] = "+-*+-*+-*/";
+    std::ostringstream out;
+    size_t depth = 0;
+
+    count = 0;
+    while (count < tokens || depth != 1)
+    {
+        bool push = depth < 2 || (count < tokens && randomBelow(state, 2) == 0);
+        if (count)
+            out << ' ';
+        if (push)
+        {
+            long value = static_cast<long>(randomBelow(state, 1000));
+            out << (randomBelow(state, 8) == 0 ? -value : value);
+            depth++;
+        }
+        else
+        {
+            out << OPERATORS[randomBelow(state, sizeof(OPERATORS) - 1)];
+            depth--;
+        }
+        count++;
+    }
+
+    if (randomBelow(state, 8) == 0)
+    {
+        switch (randomBelow(state, 3))
+        {
+            case 0: out << " x"; break;
+            case 1: out << " + +"; break;
+            default: out << " 1"; break;
+        }
+        count += 2;
+    }
+    return out.str();
+}
+
+static void report(const char* method, size_t tokens, size_t expressions,
+                   double seconds, size_t allocations)
+{
+    std::cout << std::left << std::setw(10) << method << std::right << std::fixed
+              << std::setprecision(1) << std::setw(9) << tokens / seconds / 1e6 << " Mtokens/s"
+              << std::setw(9) << seconds * 1e9 / expressions << " ns/expr"
+              << std::setprecision(2) << std::setw(8)
+              << static_cast<double>(allocations) / expressions << " allocs/expr" << std::endl;
+}
+
+/**
+ * count expressions, seed 1; returns their total number of tokens
+ */
+static size_t generateExpressions(size_t count, size_t length, std::vector<std::string>& expressions)
+{
+    uint64_t state = 1;
+    size_t tokens = 0;
+
+    expressions.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t n;
+        expressions[i] = generateExpression(state, length, n);
+        tokens += n;
+    }
+    return tokens;
+}
+
+static bool benchTokens(size_t count, size_t length)
+{
+    std::vector<std::string> expressions;
+    size_t tokens = generateExpressions(count, length, expressions);
+
+    std::vector<int> expected(count);
+    std::vector<RPN::Status> statuses(count);
+    double legacy = 0;
+    size_t legacyAllocations = 0;
+    for (int run = 0; run < RUNS; run++)
+    {
+        size_t allocations = g_allocations;
+        double start = nowSeconds();
+        for (size_t i = 0; i < count; i++)
+            statuses[i] = legacyEvaluate(expressions[i], expected[i]);
+        double seconds = nowSeconds() - start;
+        legacyAllocations = g_allocations - allocations;
+        if (run == 0 || seconds < legacy)
+            legacy = seconds;
+    }
+    report("legacy", tokens, count, legacy, legacyAllocations);
+
+    RPN rpn;
+    double fast = 0;
+    size_t fastAllocations = 0;
+    size_t mismatches = 0;
+    for (int run = 0; run < RUNS; run++)
+    {
+        size_t allocations = g_allocations;
+        double start = nowSeconds();
+        for (size_t i = 0; i < count; i++)
+        {
+            const char* text = expressions[i].data();
+            RPN::Status status = rpn.run(text, text + expressions[i].size());
+            if (status != statuses[i] || (status == RPN::STATUS_OK && rpn.getResult() != expected[i]))
+                mismatches++;
+        }
+        double seconds = nowSeconds() - start;
+        fastAllocations = g_allocations - allocations;
+        if (run == 0 || seconds < fast)
+            fast = seconds;
+    }
+    report("run", tokens, count, fast, fastAllocations);
+
+    std::cout << "speedup   " << std::setprecision(2) << legacy / fast << "x, "
+              << mismatches << " mismatches" << std::endl;
+    return mismatches == 0;
+}
+
+static bool benchBatch(size_t count, size_t length)
+{
+    static const char* const PATH = "/tmp/rpn_bench_batch.txt";
+    std::vector<std::string> expressions;
+    size_t tokens = generateExpressions(count, length, expressions);
+
+    FILE* file = std::fopen(PATH, "w");
+    if (file == NULL)
+    {
+        std::cerr << "Error: cannot write " << PATH << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < count; i++)
+        std::fprintf(file, "%s\n", expressions[i].c_str());
+    std::fclose(file);
+
+    int null = open("/dev/null", O_WRONLY);
+    double best = 0;
+    size_t bestAllocations = 0;
+    RPNBatch::Stats stats;
+    for (int run = 0; run < RUNS; run++)
+    {
+        size_t allocations = g_allocations;
+        int fd = open(PATH, O_RDONLY);
+        if (fd < 0 || null < 0)
+        {
+            std::cerr << "Error: cannot open " << PATH << " or /dev/null" << std::endl;
+            return false;
+        }
+        RPNBatch batch;
+        bool ok = batch.process(fd, null);
+        close(fd);
+        if (!ok)
+            return false;
+        if (run == 0 || batch.stats().seconds < best)
+        {
+            best = batch.stats().seconds;
+            bestAllocations = g_allocations - allocations;
+            stats = batch.stats();
+        }
+    }
+    close(null);
+
+    RPNBatch::printStats(std::cout, stats);
+    report("batch", tokens, count, best, bestAllocations);
+    return true;
+}
+
+/**
+ * FNV-1a of a file
+ */
+static uint64_t fileChecksum(const char* path)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    FILE* file = std::fopen(path, "r");
+    if (file == NULL)
+        return 0;
+    int c;
+    while ((c = std::fgetc(file)) != EOF)
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    std::fclose(file);
+    return hash;
+}
+
+static bool benchScaling(size_t count, size_t maxThreads)
+{
+    static const char* const PATH = "/tmp/rpn_bench_mixed.txt";
+    static const char* const OUT_PATH = "/tmp/rpn_bench_mixed.out";
+    uint64_t state = 7;
+
+    FILE* file = std::fopen(PATH, "w");
+    if (file == NULL)
+    {
+        std::cerr << "Error: cannot write " << PATH << std::endl;
+        return false;
+    }
+    size_t tokens = 0;
+    size_t longRun = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t length;
+        if (longRun == 0 && randomBelow(state, 20000) == 0)
+            longRun = 20;
+        if (longRun > 0)
+        {
+            length = 2000 + randomBelow(state, 3001);
+            longRun--;
+        }
+        else if (randomBelow(state, 4) == 0)
+            length = 15 + randomBelow(state, 26);
+        else
+            length = 3 + randomBelow(state, 6);
+        size_t n;
+        std::string expression = generateExpression(state, length, n);
+        tokens += n;
+        std::fprintf(file, "%s\n", expression.c_str());
+    }
+    std::fclose(file);
+
+    double base = 0;
+    uint64_t expected = 0;
+    bool same = true;
+    for (size_t threads = 1; threads <= maxThreads; threads++)
+    {
+        double best = 0;
+        RPNBatch::Stats stats;
+        for (int run = 0; run < RUNS; run++)
+        {
+            int in = open(PATH, O_RDONLY);
+            int out = open(OUT_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (in < 0 || out < 0)
+            {
+                std::cerr << "Error: cannot open " << PATH << " or " << OUT_PATH << std::endl;
+                return false;
+            }
+            RPNBatch batch;
+            batch.setThreadCount(threads);
+            bool ok = batch.process(in, out);
+            close(in);
+            close(out);
+            if (!ok)
+                return false;
+            if (run == 0 || batch.stats().seconds < best)
+            {
+                best = batch.stats().seconds;
+                stats = batch.stats();
+            }
+        }
+
+        uint64_t checksum = fileChecksum(OUT_PATH);
+        if (threads == 1)
+        {
+            base = best;
+            expected = checksum;
+        }
+        same = same && (checksum == expected);
+        std::cout << "threads " << std::setw(3) << threads << std::fixed << std::setprecision(1)
+                  << std::setw(9) << tokens / best / 1e6 << " Mtokens/s"
+                  << std::setprecision(2) << std::setw(8) << stats.lines / best / 1e6 << " M lines/s"
+                  << std::setw(7) << base / best << "x  steals " << stats.steals
+                  << (checksum == expected ? "" : "  OUTPUT DIFFERS") << std::endl;
+    }
+    return same;
+}
+
+static bool benchColumns(size_t rows, const std::string& expression)
+{
+    RPNProgram program;
+    if (!program.compile(expression))
+        return false;
+
+    uint64_t state = 3;
+    size_t variables = program.variableCount();
+    std::vector<std::vector<int> > columns(variables, std::vector<int>(rows));
+    std::vector<const int*> pointers(variables);
+    for (size_t v = 0; v < variables; v++)
+    {
+        for (size_t r = 0; r < rows; r++)
+            columns[v][r] = static_cast<int>(randomBelow(state, 2001)) - 1000;
+        pointers[v] = &columns[v][0];
+    }
+
+    std::vector<int> expected(rows);
+    std::vector<unsigned char> expectedOk(rows);
+    std::vector<int> values(variables + 1);
+    std::vector<int> stack(program.stackSize());
+    double perRow = 0;
+    for (int run = 0; run < RUNS; run++)
+    {
+        double start = nowSeconds();
+        for (size_t r = 0; r < rows; r++)
+        {
+            for (size_t v = 0; v < variables; v++)
+                values[v] = pointers[v][r];
+            expectedOk[r] = program.run(&values[0], expected[r], &stack[0]);
+            if (!expectedOk[r])
+                expected[r] = 0;
+        }
+        double seconds = nowSeconds() - start;
+        if (run == 0 || seconds < perRow)
+            perRow = seconds;
+    }
+
+    std::vector<int> out(rows);
+    std::vector<unsigned char> ok(rows);
+    double columnar = 0;
+    size_t failures = 0;
+    for (int run = 0; run < RUNS; run++)
+    {
+        double start = nowSeconds();
+        failures = program.runColumns(variables ? &pointers[0] : NULL, rows, &out[0], &ok[0]);
+        double seconds = nowSeconds() - start;
+        if (run == 0 || seconds < columnar)
+            columnar = seconds;
+    }
+
+    size_t mismatches = 0;
+    for (size_t r = 0; r < rows; r++)
+        mismatches += (out[r] != expected[r] || ok[r] != expectedOk[r]);
+
+    std::cout << '"' << expression << "\"\n" << std::fixed << std::setprecision(1)
+              << "  run        " << std::setw(8) << rows / perRow / 1e6 << " M rows/s\n"
+              << "  runColumns " << std::setw(8) << rows / columnar / 1e6 << " M rows/s  "
+              << std::setprecision(2) << perRow / columnar << "x, "
+              << failures << " failed rows, " << mismatches << " mismatches" << std::endl;
+    return mismatches == 0;
+}
+
+/**
+ * Time `evaluations` runs of program; variable v of run i is i + v
+ */
+static double timeProgram(const RPNProgram& program, size_t evaluations, int64_t& checksum)
+{
+    std::vector<int> values(program.variableCount() + 1);
+    std::vector<int> stack(program.stackSize());
+    double best = 0;
+
+    for (int run = 0; run < RUNS; run++)
+    {
+        checksum = 0;
+        double start = nowSeconds();
+        for (size_t i = 0; i < evaluations; i++)
+        {
+            for (size_t v = 0; v < program.variableCount(); v++)
+                values[v] = static_cast<int>(i + v);
+            int result;
+            checksum += program.run(&values[0], result, &stack[0]) ? result : 12345;
+        }
+        double seconds = nowSeconds() - start;
+        if (run == 0 || seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+static bool benchOptimize(size_t evaluations, const std::string& expression)
+{
+    RPNProgram plain;
+    if (!plain.compile(expression))
+        return false;
+    RPNProgram optimized = plain;
+    size_t removed = optimized.optimize();
+
+    int64_t plainSum;
+    int64_t optimizedSum;
+    double plainSeconds = timeProgram(plain, evaluations, plainSum);
+    double optimizedSeconds = timeProgram(optimized, evaluations, optimizedSum);
+
+    std::cout << '"' << expression << "\"\n  " << plain.code().size() << " -> "
+              << optimized.code().size() << " instructions (" << removed << " removed), "
+              << std::fixed << std::setprecision(1)
+              << plainSeconds * 1e9 / evaluations << " -> "
+              << optimizedSeconds * 1e9 / evaluations << " ns/run, "
+              << std::setprecision(2) << plainSeconds / optimizedSeconds << "x"
+              << (plainSum == optimizedSum ? "" : ", RESULTS DIFFER") << std::endl;
+    return plainSum == optimizedSum;
+}
+
+/**
+ * A random valid program of up to 24 tokens
+ */
+static std::string randomProgram(uint64_t& state)
+{
+    static const char* const OPERANDS[] = {
+        "0", "1", "-1", "2", "7", "2147483647", "-2147483648", "x", "y", "z"
+    };
+    static const char OPERATORS[] = "+-*/";
+    std::string out;
+    size_t depth = 0;
+    size_t tokens = 1 + randomBelow(state, 24);
+
+    for (size_t count = 0; count < tokens || depth != 1; count++)
+    {
+        if (!out.empty())
+            out += ' ';
+        if (depth < 2 || (count < tokens && randomBelow(state, 2) == 0))
+        {
+            out += OPERANDS[randomBelow(state, sizeof(OPERANDS) / sizeof(OPERANDS[0]))];
+            depth++;
+        }
+        else
+        {
+            out += OPERATORS[randomBelow(state, 4)];
+            depth--;
+        }
+    }
+    return out;
+}
+
+static bool checkOptimize(size_t programs)
+{
+    static const int VALUES[] = { 0, 1, -1, 2, 3, 1000, 2147483647, -2147483647 - 1 };
+    uint64_t state = 11;
+    size_t removed = 0;
+    size_t instructions = 0;
+    size_t mismatches = 0;
+
+    for (size_t i = 0; i < programs; i++)
+    {
+        std::string expression = randomProgram(state);
+        RPNProgram plain;
+        if (!plain.compile(expression))
+            return false;
+        RPNProgram optimized = plain;
+        removed += optimized.optimize();
+        instructions += plain.code().size();
+
+        std::vector<int> values(plain.variableCount() + 1);
+        for (int trial = 0; trial < 8; trial++)
+        {
+            for (size_t v = 0; v < plain.variableCount(); v++)
+                values[v] = VALUES[randomBelow(state, sizeof(VALUES) / sizeof(VALUES[0]))];
+            int a = 0;
+            int b = 0;
+            bool okA = plain.run(&values[0], a);
+            bool okB = optimized.run(&values[0], b);
+            if (okA != okB || (okA && a != b))
+            {
+                if (mismatches++ < 5)
+                    std::cout << "mismatch: \"" << expression << '"' << std::endl;
+            }
+        }
+    }
+    std::cout << programs << " random programs: " << removed << " of " << instructions
+              << " instructions removed, " << mismatches << " mismatches" << std::endl;
+    return mismatches == 0;
+}
+
+static int usage(const char* name)
+{
+    std::cerr << "Usage: " << name << " tokens [expressions [tokens]]\n"
+              << "       " << name << " batch [expressions [tokens]]\n"
+              << "       " << name << " scaling [expressions [threads]]\n"
+              << "       " << name << " columns [rows [expression]]\n"
+              << "       " << name << " optimize [evaluations [expression]]" << std::endl;
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        return usage(argv[0]);
+
+    std::string command = argv[1];
+    if (command == "tokens" && argc <= 4)
+    {
+        size_t count = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 200000;
+        size_t length = (argc > 3) ? std::strtoul(argv[3], NULL, 10) : 15;
+        if (count == 0 || length == 0)
+            return usage(argv[0]);
+        return benchTokens(count, length) ? 0 : 1;
+    }
+    if (command == "batch" && argc <= 4)
+    {
+        size_t count = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 1000000;
+        size_t length = (argc > 3) ? std::strtoul(argv[3], NULL, 10) : 15;
+        if (count == 0 || length == 0)
+            return usage(argv[0]);
+        return benchBatch(count, length) ? 0 : 1;
+    }
+    if (command == "scaling" && argc <= 4)
+    {
+        size_t count = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 1000000;
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t threads = (argc > 3) ? std::strtoul(argv[3], NULL, 10) : (cpus > 0 ? cpus : 1);
+        if (count == 0 || threads == 0)
+            return usage(argv[0]);
+        return benchScaling(count, threads) ? 0 : 1;
+    }
+    if (command == "columns" && argc <= 4)
+    {
+        static const char* const EXPRESSIONS[] = {
+            "x 3 * y -", "x y * z + x y - *", "x y / 7 +", "a b + c d + * e 2 * -"
+        };
+        size_t rows = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 10000000;
+        if (rows == 0)
+            return usage(argv[0]);
+        if (argc > 3)
+            return benchColumns(rows, argv[3]) ? 0 : 1;
+        bool ok = true;
+        for (size_t i = 0; i < sizeof(EXPRESSIONS) / sizeof(EXPRESSIONS[0]); i++)
+            ok = benchColumns(rows, EXPRESSIONS[i]) && ok;
+        return ok ? 0 : 1;
+    }
+    if (command == "optimize" && argc <= 4)
+    {
+        static const char* const EXPRESSIONS[] = {
+            "8 9 * 9 - 9 - 9 - 4 - 1 +",
+            "x 8 9 * 9 - 9 - 9 - * 4 + y 1 * 0 + -",
+            "x 0 + 1 * y 1 / 0 - * 2 3 * 1 + +",
+            "x 2147483647 1 + * 1 0 / +"
+        };
+        size_t evaluations = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 10000000;
+        if (evaluations == 0)
+            return usage(argv[0]);
+        bool ok = true;
+        if (argc > 3)
+            ok = benchOptimize(evaluations, argv[3]);
+        else
+        {
+            for (size_t i = 0; i < sizeof(EXPRESSIONS) / sizeof(EXPRESSIONS[0]); i++)
+                ok = benchOptimize(evaluations, EXPRESSIONS[i]) && ok;
+        }
+        return (checkOptimize(100000) && ok) ? 0 : 1;
+    }
+    return usage(argv[0]);
+}